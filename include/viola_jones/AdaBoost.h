@@ -5,9 +5,28 @@
 #include <vector>
 #include <cstddef>
 #include <string>
+#include <sstream>
+#include <cfloat>
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
 
 namespace vj {
 
+// largest table a weak learner may have (bins are stored as bytes by the optimizer)
+constexpr std::size_t kMaxLutBins = 256;
+
+// bin of feature value v in a table of n bins spanning [lo, hi), values
+// outside go to the first/last bin. shared by every evaluator of a table so
+// they all pick the same bin
+inline std::size_t lutBin(long long v, double lo, double hi, std::size_t n) {
+    if (!(hi > lo)) return 0;
+    double t = (static_cast<double>(v) - lo) / (hi - lo) * static_cast<double>(n);
+    if (!(t > 0)) return 0;
+    if (t >= static_cast<double>(n)) return n - 1;
+    return static_cast<std::size_t>(t);
+}
+
 template<typename T>
 class AdaBoost {
     friend class Trainer; // Allow Trainer to access private members
@@ -17,26 +36,69 @@ public:
         T           thresh;
         int         polarity;  // ±1
         double      alpha;     // weight
+
+        // confidence-rated learner (Real/Gentle AdaBoost) when not empty:
+        // adds lut[bin of the feature value over [lo, hi)] instead of a vote
+        std::vector<double> lut;
+        double      lo = 0, hi = 0;
+
+        bool isLut() const { return !lut.empty(); }
+
+        // what this learner adds to the stage sum for feature value v
+        double output(long long v) const {
+            if (isLut()) return lut[lutBin(v, lo, hi, lut.size())];
+            return (polarity * v < polarity * thresh) ? alpha : 0.0;
+        }
+        double maxOutput() const {
+            return isLut() ? *std::max_element(lut.begin(), lut.end()) : std::max(0.0, alpha);
+        }
+        double minOutput() const {
+            return isLut() ? *std::min_element(lut.begin(), lut.end()) : std::min(0.0, alpha);
+        }
+        double maxAbsOutput() const { return std::max(std::abs(maxOutput()), std::abs(minOutput())); }
     };
 
     // add one weak classifier
-    void add(Weak w) { weaks_.push_back(std::move(w)); }
+    void add(Weak w) {
+        weaks_.push_back(std::move(w));
+        updateBounds();
+    }
 
     // weighted vote
-    bool classify(const Image<long long>& I,
+    template<typename S>
+    bool classify(const Image<S>& I,
                   std::size_t ox, std::size_t oy) const
     {
+        std::size_t evaluated = 0;
+        return classify(I, ox, oy, evaluated);
+    }
+
+    // same, stops as soon as the remaining learners cannot change the
+    // outcome; `evaluated` is increased by the learners actually run.
+    // the margin covers the rounding of the double sums, so the decision is
+    // exactly the one of the full sum
+    template<typename S>
+    bool classify(const Image<S>& I,
+                  std::size_t ox, std::size_t oy, std::size_t& evaluated) const
+    {
+        const double margin = 4 * (weaks_.size() + 1) * DBL_EPSILON
+                            * (abs_total_ + std::abs(threshold_));
         double sum = 0;
-        for (auto const& w : weaks_) {
-            auto val = w.feat(I, ox, oy);
-            int vote = (w.polarity * val < w.polarity * w.thresh) ? 1 : 0;
-            sum += vote * w.alpha;
+        for (std::size_t k = 0; k < weaks_.size(); ++k) {
+            auto const& w = weaks_[k];
+            sum += w.output(w.feat(I, ox, oy));
+            if (sum + rest_lo_[k] - margin > threshold_) { evaluated += k + 1; return true; }
+            if (sum + rest_hi_[k] + margin <= threshold_) { evaluated += k + 1; return false; }
         }
+        evaluated += weaks_.size();
         return sum > threshold_;
     }
 
     // adjust final threshold if needed
     void setThreshold(double t) { threshold_ = t; }
+    double threshold() const { return threshold_; }
+
+    const std::vector<Weak>& weaks() const { return weaks_; }
 
     // serialization
     void save(std::ostream& os) const {
@@ -46,6 +108,13 @@ public:
         // 1) serialize feature
         w.feat.save(os);
         // 2) serialize thresh, polarity, alpha
+        //    or for a table: lut nbins lo hi values...
+        if (w.isLut()) {
+          os << "lut " << w.lut.size() << " " << w.lo << " " << w.hi;
+          for (double v : w.lut) os << " " << v;
+          os << "\n";
+          continue;
+        }
         os << w.thresh << " "
            << w.polarity << " "
            << w.alpha << "\n";
@@ -62,11 +131,26 @@ public:
       for (size_t i = 0; i < K; ++i) {
         // a) load feature
         auto feat = HaarFeature<T>::load(is);
-        // b) load thresh, polarity, alpha
+        // b) load thresh, polarity, alpha, or a table
+        std::string first;
+        is >> first;
+        if (first == "lut") {
+          Weak w{feat, T{}, 1, 0.0, {}};
+          std::size_t n = 0;
+          is >> n >> w.lo >> w.hi;
+          if (n == 0 || n > kMaxLutBins)
+            throw std::runtime_error("lut with " + std::to_string(n) + " bins, expected 1.." + std::to_string(kMaxLutBins));
+          w.lut.resize(n);
+          for (auto& v : w.lut) is >> v;
+          ab.weaks_.push_back(std::move(w));
+          continue;
+        }
         T thresh; int polarity; double alpha;
-        is >> thresh >> polarity >> alpha;
-        ab.weaks_.push_back({feat, thresh, polarity, alpha});
+        std::istringstream(first) >> thresh;
+        is >> polarity >> alpha;
+        ab.weaks_.push_back({feat, thresh, polarity, alpha, {}});
       }
+      ab.updateBounds();
       // load threshold
       is >> ab.threshold_;
       return ab;
@@ -75,6 +159,22 @@ public:
 private:
     std::vector<Weak> weaks_;
     double threshold_ = 0.5;
+
+    // what the learners after k can still add at most / at least
+    std::vector<double> rest_hi_, rest_lo_;
+    double abs_total_ = 0;
+
+    void updateBounds() {
+        const std::size_t K = weaks_.size();
+        rest_hi_.assign(K, 0);
+        rest_lo_.assign(K, 0);
+        abs_total_ = 0;
+        for (std::size_t k = K; k-- > 1;) {
+            rest_hi_[k-1] = rest_hi_[k] + weaks_[k].maxOutput();
+            rest_lo_[k-1] = rest_lo_[k] + weaks_[k].minOutput();
+        }
+        for (auto const& w : weaks_) abs_total_ += w.maxAbsOutput();
+    }
 };
 
 } // namespace vj
@@ -24,9 +24,20 @@ public:
     void setThreshold(double t) {
         threshold_ = t;
     }
+    double threshold() const { return threshold_; }
+
+    const std::vector<AdaBoost<T>>& stages() const { return stages_; }
+
+    // moves every stage threshold by `delta` (in alpha units), the knob
+    // trading detection rate against false positives
+    void offsetStageThresholds(double delta) {
+        for (auto& s : stages_)
+            s.setThreshold(s.threshold() + delta);
+    }
 
     // the cascade on an integral‐image window at (x,y)
-    bool classify(const Image<long long>& I, std::size_t x, std::size_t y) const {
+    template<typename S>
+    bool classify(const Image<S>& I, std::size_t x, std::size_t y) const {
         double sum = 0;
         for (auto const& stage : stages_) {
             if (!stage.classify(I, x, y))
@@ -0,0 +1,218 @@
+#ifndef CASCADE_OPTIMIZER_HPP
+#define CASCADE_OPTIMIZER_HPP
+
+#include "CascadeClassifier.h"
+#include "CompiledCascade.h"
+#include "Image.h"
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <ostream>
+#include <iomanip>
+#include <stdexcept>
+
+// offline cascade optimizer: records, on validation windows, which weak
+// learners vote in every stage the window reaches, then reorders the
+// learners of each stage so that the outcome of the stage is settled as early
+// as possible. a prefix settles it once the partial sum stays above the
+// threshold even if no remaining learner votes, or stays at/below it even if
+// all of them vote; that is where the detector's early exit stops, so the
+// mean settling depth is the cost being minimized.
+// reordering never changes a decision of the cascade.
+// table learners are recorded by their bin instead of a vote (so at most 256
+// bins) and bounded by their smallest/largest table entry
+
+namespace vj {
+
+struct StageReport {
+    std::size_t weaks   = 0;
+    std::size_t windows = 0;    // validation windows reaching the stage
+    double      depth_before = 0;  // mean learners needed to settle the stage
+    double      depth_after  = 0;
+};
+
+struct OptimizerReport {
+    std::size_t              windows = 0;
+    double                   settle_before = 0;  // per window, learners up to the settling one
+    double                   settle_after  = 0;
+    std::vector<StageReport> stages;
+
+    void print(std::ostream& os) const {
+        os << "validation windows: " << windows << "\n"
+           << std::setw(6) << "stage" << std::setw(8) << "weaks" << std::setw(12) << "reach %"
+           << std::setw(14) << "depth before" << std::setw(13) << "depth after" << "\n";
+        for (std::size_t s = 0; s < stages.size(); ++s) {
+            auto const& st = stages[s];
+            os << std::setw(6) << s << std::setw(8) << st.weaks
+               << std::setw(12) << std::fixed << std::setprecision(2)
+               << 100.0 * st.windows / std::max<std::size_t>(1, windows)
+               << std::setw(14) << st.depth_before << std::setw(13) << st.depth_after << "\n";
+        }
+        os << "features per window (settling point): " << settle_before << " -> " << settle_after << "\n";
+    }
+};
+
+template<typename T>
+class CascadeOptimizer {
+public:
+    explicit CascadeOptimizer(const CascadeClassifier<T>& cascade)
+      : cascade_(cascade), compiled_(cascade), votes_(cascade.stages().size())
+    {
+        // bins are recorded as bytes
+        for (auto const& s : cascade.stages())
+            for (auto const& w : s.weaks())
+                if (w.lut.size() > kMaxLutBins)
+                    throw std::invalid_argument("CascadeOptimizer: table with more than 256 bins");
+    }
+
+    // record one window: the votes (table bins) of every stage it reaches
+    void addWindow(const Image<long long>& I, std::size_t x, std::size_t y) {
+        windows_++;
+        auto const& stages = compiled_.stages();
+        for (std::size_t s = 0; s < stages.size(); ++s) {
+            std::int64_t sum = 0;
+            for (auto const& w : stages[s].weaks) {
+                auto code = w.code(w.feat(I, x, y));
+                votes_[s].push_back(static_cast<std::uint8_t>(code));
+                sum += w.output(code);
+            }
+            if (!(sum > stages[s].threshold))
+                break;
+        }
+    }
+
+    std::size_t windows() const { return windows_; }
+
+    CascadeClassifier<T> optimize(OptimizerReport& report) const
+    {
+        CascadeClassifier<T> out;
+        out.setThreshold(cascade_.threshold());
+        report = {};
+        report.windows = windows_;
+
+        auto const& stages = cascade_.stages();
+        for (std::size_t s = 0; s < stages.size(); ++s) {
+            auto const& cs = compiled_.stages()[s];
+            const std::size_t K = cs.weaks.size();
+            const std::size_t W = K ? votes_[s].size() / K : 0;
+
+            StageReport sr;
+            sr.weaks = K;
+            sr.windows = W;
+
+            std::vector<std::size_t> identity(K);
+            for (std::size_t i = 0; i < K; ++i) identity[i] = i;
+            auto order = W ? greedyOrder(s) : identity;
+
+            sr.depth_before = meanSettleDepth(s, identity);
+            sr.depth_after  = meanSettleDepth(s, order);
+
+            double reach = windows_ ? static_cast<double>(W) / windows_ : 0;
+            report.settle_before += reach * sr.depth_before;
+            report.settle_after  += reach * sr.depth_after;
+
+            // reordered stage, same threshold
+            AdaBoost<T> full;
+            for (auto i : order) full.add(stages[s].weaks()[i]);
+            full.setThreshold(stages[s].threshold());
+            out.addStage(full);
+            report.stages.push_back(sr);
+        }
+        return out;
+    }
+
+private:
+    CascadeClassifier<T>                   cascade_;
+    CompiledCascade<T>                     compiled_;   // decisions are made in fixed point, like the detector
+    std::vector<std::vector<std::uint8_t>> votes_;      // per stage: windows x learners, vote or bin
+    std::size_t                            windows_ = 0;
+
+    using CWeak = typename CompiledCascade<T>::Weak;
+    static std::int64_t hi(const CWeak& w) { return w.maxOutput(); }
+    static std::int64_t lo(const CWeak& w) { return w.minOutput(); }
+
+    // settled after the prefix: accepted whatever the rest does, or rejected whatever the rest does
+    static bool settled(std::int64_t sum, std::int64_t rest_hi, std::int64_t rest_lo, std::int64_t thr) {
+        return sum + rest_hi <= thr || sum + rest_lo > thr;
+    }
+
+    // learners needed, averaged over the windows reaching stage s. like the
+    // detector's early exit, the first learner is always run
+    double meanSettleDepth(std::size_t s, const std::vector<std::size_t>& order) const {
+        auto const& cs = compiled_.stages()[s];
+        const std::size_t K = cs.weaks.size();
+        const std::size_t W = K ? votes_[s].size() / K : 0;
+        if (W == 0) return static_cast<double>(K);
+
+        std::vector<std::int64_t> rest_hi(K + 1, 0), rest_lo(K + 1, 0);
+        for (std::size_t k = K; k-- > 0;) {
+            rest_hi[k] = rest_hi[k+1] + hi(cs.weaks[order[k]]);
+            rest_lo[k] = rest_lo[k+1] + lo(cs.weaks[order[k]]);
+        }
+        double total = 0;
+        for (std::size_t w = 0; w < W; ++w) {
+            const std::uint8_t* v = &votes_[s][w * K];
+            std::int64_t sum = 0;
+            std::size_t k = 0;
+            do {
+                sum += cs.weaks[order[k]].output(v[order[k]]);
+                ++k;
+            } while (k < K && !settled(sum, rest_hi[k], rest_lo[k], cs.threshold));
+            total += static_cast<double>(k);
+        }
+        return total / W;
+    }
+
+    // greedy: next learner = the one that settles the most still open windows
+    std::vector<std::size_t> greedyOrder(std::size_t s) const {
+        auto const& cs = compiled_.stages()[s];
+        const std::size_t K = cs.weaks.size();
+        const std::size_t W = votes_[s].size() / K;
+
+        std::vector<std::size_t> order;
+        std::vector<bool> used(K, false);
+        std::vector<std::int64_t> sum(W, 0);
+        std::vector<std::size_t> open;
+        std::int64_t rest_hi = 0, rest_lo = 0;
+        for (auto const& w : cs.weaks) { rest_hi += hi(w); rest_lo += lo(w); }
+        for (std::size_t w = 0; w < W; ++w)
+            if (!settled(0, rest_hi, rest_lo, cs.threshold)) open.push_back(w);
+
+        while (order.size() < K) {
+            std::size_t best = K, best_count = 0;
+            for (std::size_t j = 0; j < K; ++j) {
+                if (used[j]) continue;
+                auto const& a = cs.weaks[j];
+                const std::int64_t rh = rest_hi - hi(a), rl = rest_lo - lo(a);
+                std::size_t count = 0;
+                for (auto w : open) {
+                    std::int64_t sm = sum[w] + a.output(votes_[s][w * K + j]);
+                    count += settled(sm, rh, rl, cs.threshold);
+                }
+                // ties: the learner with the widest output range
+                if (best == K || count > best_count ||
+                    (count == best_count && hi(a) - lo(a) > hi(cs.weaks[best]) - lo(cs.weaks[best]))) {
+                    best = j;
+                    best_count = count;
+                }
+            }
+            used[best] = true;
+            order.push_back(best);
+            auto const& a = cs.weaks[best];
+            rest_hi -= hi(a);
+            rest_lo -= lo(a);
+            std::vector<std::size_t> still_open;
+            for (auto w : open) {
+                sum[w] += a.output(votes_[s][w * K + best]);
+                if (!settled(sum[w], rest_hi, rest_lo, cs.threshold)) still_open.push_back(w);
+            }
+            open.swap(still_open);
+        }
+        return order;
+    }
+};
+
+} // namespace vj
+
+#endif // CASCADE_OPTIMIZER_HPP
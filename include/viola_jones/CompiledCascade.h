@@ -0,0 +1,308 @@
+#ifndef COMPILED_CASCADE_HPP
+#define COMPILED_CASCADE_HPP
+
+#include "CascadeClassifier.h"
+#include "HaarFeature.h"
+#include "Image.h"
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+// inference-only form of a CascadeClassifier, built once at load time:
+//   - polarity is folded into the feature (white/black swapped) and the
+//     threshold negated, so every weak learner votes iff  value < thresh
+//   - alphas and the stage threshold are quantized to int32 fixed point with
+//     a per-stage power-of-two scale, so a weak learner is one compare and one
+//     masked integer add, no doubles in the window loop
+//
+// quantization error: each alpha and the threshold are rounded to the nearest
+// 1/scale, so the fixed-point sum can only disagree with the double-precision
+// one for windows whose score is within `error_bound` of the stage threshold
+// (error_bound = (K+1) / (2*scale), K = weak learners in the stage)
+//
+// early exit: every learner also carries the sum bounds at which the stage is
+// settled after it (accepted whatever the remaining learners vote, or rejected
+// even if all of them vote). integer sums are exact, so stopping there gives
+// the same decision as the full sum
+//
+// table learners (Real/Gentle AdaBoost) keep their feature as is and have
+// every table entry quantized like an alpha. the bin boundaries of lutBin()
+// are turned into integer edges at load time (the first feature value of
+// every bin) and the value range is cut into power-of-two cells holding at
+// most one edge each, so the window loop finds the same bin as the
+// double-precision stage with an offset, a shift and one compare, no divide.
+// stump stages and table stages run separate loops; a stump in a table stage
+// becomes a two-bin table
+
+namespace vj {
+
+template<typename T>
+class CompiledCascade {
+public:
+    struct Weak {
+        HaarFeature<T> feat;    // polarity already folded in
+        long long      thresh;  // votes iff feat(...) < thresh
+        std::int32_t   alpha;   // fixed point, alpha * scale
+        std::int64_t   accept;  // stage passes if the sum so far is > accept
+        std::int64_t   reject;  // ...fails if it is <= reject
+
+        std::vector<std::int32_t> lut;  // fixed point, empty for a stump
+
+        // bin lookup: values base + [c << shift, (c+1) << shift) fall in cell c,
+        // which starts in bin `bin` and moves up by `jump` bins from `edge` on
+        struct Cell {
+            long long     edge = std::numeric_limits<long long>::max();
+            std::uint16_t bin = 0, jump = 0;
+        };
+        std::vector<Cell> cells;
+        long long         base = 0, span = 0;  // values outside [base, base+span] are clamped
+        unsigned          shift = 0;
+
+        std::size_t bin(long long v) const {
+            const long long d = std::clamp(v - base, 0LL, span);
+            auto const& c = cells[static_cast<std::size_t>(d) >> shift];
+            return c.bin + static_cast<std::size_t>(v >= c.edge) * c.jump;
+        }
+
+        // vote (0/1) or table bin for feature value v, and what it adds
+        std::size_t code(long long v) const {
+            return lut.empty() ? static_cast<std::size_t>(v < thresh) : bin(v);
+        }
+        std::int32_t output(std::size_t code) const {
+            return lut.empty() ? (code ? alpha : 0) : lut[code];
+        }
+        std::int32_t maxOutput() const {
+            return lut.empty() ? std::max<std::int32_t>(0, alpha) : *std::max_element(lut.begin(), lut.end());
+        }
+        std::int32_t minOutput() const {
+            return lut.empty() ? std::min<std::int32_t>(0, alpha) : *std::min_element(lut.begin(), lut.end());
+        }
+    };
+
+    struct Stage {
+        std::vector<Weak> weaks;
+        std::int32_t      threshold = 0;   // fixed point, passes iff sum > threshold
+        double            scale = 1;       // fixed point = real * scale
+        double            error_bound = 0; // see above, in alpha units
+        bool              tables = false;  // every learner is a table
+    };
+
+    // how much work the windows took
+    struct EvalStats {
+        std::uint64_t windows  = 0;
+        std::uint64_t stages   = 0;  // stages evaluated
+        std::uint64_t features = 0;  // weak learners evaluated
+
+        double perStage()  const { return stages  ? static_cast<double>(features) / stages  : 0; }
+        double perWindow() const { return windows ? static_cast<double>(features) / windows : 0; }
+    };
+
+    CompiledCascade() = default;
+
+    explicit CompiledCascade(const CascadeClassifier<T>& cascade) {
+        for (auto const& s : cascade.stages())
+            stages_.push_back(compileStage(s));
+    }
+
+    template<typename S>
+    bool classify(const Image<S>& I, std::size_t x, std::size_t y) const {
+        for (auto const& stage : stages_) {
+            if (!classifyStage(stage, I, x, y))
+                return false;  // early reject
+        }
+        return true;
+    }
+
+    template<typename S>
+    bool classify(const Image<S>& I, std::size_t x, std::size_t y, EvalStats& stats) const {
+        stats.windows++;
+        for (auto const& stage : stages_) {
+            std::size_t n = 0;
+            bool pass = classifyStage(stage, I, x, y, n);
+            stats.stages++;
+            stats.features += n;
+            if (!pass)
+                return false;
+        }
+        return true;
+    }
+
+    template<typename S>
+    static bool classifyStage(const Stage& stage, const Image<S>& I,
+                              std::size_t x, std::size_t y)
+    {
+        std::size_t evaluated = 0;
+        return classifyStage(stage, I, x, y, evaluated);
+    }
+
+    // `evaluated` is increased by the learners actually run
+    template<typename S>
+    static bool classifyStage(const Stage& stage, const Image<S>& I,
+                              std::size_t x, std::size_t y, std::size_t& evaluated)
+    {
+        return stage.tables ? runStage<true>(stage, I, x, y, evaluated)
+                            : runStage<false>(stage, I, x, y, evaluated);
+    }
+
+    // confidence of a window the cascade accepted: how far the full sum of
+    // the last stage is above its threshold, in alpha units (> 0 for a hit)
+    template<typename S>
+    double score(const Image<S>& I, std::size_t x, std::size_t y) const {
+        if (stages_.empty()) return 0;
+        auto const& stage = stages_.back();
+        std::int64_t sum = 0;
+        for (auto const& w : stage.weaks)
+            sum += w.output(w.code(w.feat(I, x, y)));
+        return static_cast<double>(sum - stage.threshold) / stage.scale;
+    }
+
+    const std::vector<Stage>& stages() const { return stages_; }
+
+    // largest error_bound over all stages
+    double errorBound() const {
+        double b = 0;
+        for (auto const& s : stages_) b = std::max(b, s.error_bound);
+        return b;
+    }
+
+private:
+    std::vector<Stage> stages_;
+
+    template<bool Tables, typename S>
+    static bool runStage(const Stage& stage, const Image<S>& I,
+                         std::size_t x, std::size_t y, std::size_t& evaluated)
+    {
+        std::int32_t sum = 0;
+        for (std::size_t k = 0; k < stage.weaks.size(); ++k) {
+            auto const& w = stage.weaks[k];
+            const long long v = w.feat(I, x, y);
+            if constexpr (Tables) {
+                sum += w.lut[w.bin(v)];
+            } else {
+                // all-ones mask when the learner votes, zero otherwise
+                std::int32_t mask = -static_cast<std::int32_t>(v < w.thresh);
+                sum += w.alpha & mask;
+            }
+            if (sum > w.accept)  { evaluated += k + 1; return true; }
+            if (sum <= w.reject) { evaluated += k + 1; return false; }
+        }
+        evaluated += stage.weaks.size();
+        return sum > stage.threshold;
+    }
+
+    static Stage compileStage(const AdaBoost<T>& ab) {
+        Stage st;
+        auto const& weaks = ab.weaks();
+
+        // largest power-of-two scale that keeps any partial sum and the
+        // threshold well inside int32
+        double mag = std::abs(ab.threshold());
+        double total = 0;
+        for (auto const& w : weaks) total += w.maxAbsOutput();
+        mag = std::max({ mag, total, 1e-12 });
+        int exp = 0;
+        std::frexp(mag, &exp);   // mag < 2^exp
+        st.scale = std::ldexp(1.0, 30 - exp);
+
+        for (auto const& w : weaks) {
+            Weak cw{ w.feat, 0, quantize(w.alpha, st.scale), 0, 0, {}, {} };
+            if (w.isLut()) {
+                for (double v : w.lut) cw.lut.push_back(quantize(v, st.scale));
+                binCells(cw, w.lo, w.hi, w.lut.size());
+                st.tables = true;
+            } else if (w.polarity > 0) {
+                cw.thresh = static_cast<long long>(w.thresh);
+            } else if (w.polarity < 0) {
+                // -v < -t  <=>  v > t
+                cw.feat   = HaarFeature<T>(w.feat.black(), w.feat.white());
+                cw.thresh = -static_cast<long long>(w.thresh);
+            } else {
+                // 0 * v < 0 never holds, the learner never votes
+                cw.thresh = std::numeric_limits<long long>::min();
+            }
+            st.weaks.push_back(std::move(cw));
+        }
+        // mixed stage: stumps become tables, bin 0 (v < thresh) adds alpha
+        if (st.tables) {
+            for (auto& cw : st.weaks) {
+                if (!cw.lut.empty()) continue;
+                cw.lut   = { cw.alpha, 0 };
+                cw.cells = { { cw.thresh, 0, 1 } };
+            }
+        }
+        st.threshold   = quantize(ab.threshold(), st.scale);
+
+        // settling bounds from the suffix sums of the remaining alphas
+        std::int64_t rest_hi = 0, rest_lo = 0;
+        for (std::size_t k = st.weaks.size(); k-- > 0;) {
+            st.weaks[k].accept = st.threshold - rest_lo;
+            st.weaks[k].reject = st.threshold - rest_hi;
+            rest_hi += st.weaks[k].maxOutput();
+            rest_lo += st.weaks[k].minOutput();
+        }
+        st.error_bound = (static_cast<double>(weaks.size()) + 1) / (2 * st.scale);
+        return st;
+    }
+
+    // integer form of lutBin(., lo, hi, n). edges[b-1] = smallest value it
+    // puts in bin b or above; lutBin never decreases with v, so a bisection
+    // per bin finds it. the cell width is the largest power of two not above
+    // the smallest gap between distinct edges, so no cell holds two of them
+    static void binCells(Weak& cw, double lo, double hi, std::size_t n) {
+        using Cell = typename Weak::Cell;
+        cw.cells = { Cell{} };
+        cw.base = cw.span = 0;
+        cw.shift = 0;
+        if (!(hi > lo) || n < 2) return;  // everything in bin 0
+
+        // lutBin is n-1 from top on, 0 up to base
+        const long long base = static_cast<long long>(std::floor(lo)) - 1;
+        const long long top  = static_cast<long long>(std::ceil(hi)) + 1;
+        std::vector<long long> edges(n - 1);
+        for (std::size_t b = 1; b < n; ++b) {
+            long long a = base, c = top;  // lutBin(a) < b <= lutBin(c)
+            while (c - a > 1) {
+                long long m = a + (c - a) / 2;
+                if (lutBin(m, lo, hi, n) >= b) c = m;
+                else a = m;
+            }
+            edges[b - 1] = c;
+        }
+
+        long long gap = top - base;
+        for (std::size_t b = 1; b < edges.size(); ++b)
+            if (edges[b] != edges[b - 1]) gap = std::min(gap, edges[b] - edges[b - 1]);
+        unsigned shift = 0;
+        while ((2LL << shift) <= gap) ++shift;
+
+        cw.base  = base;
+        cw.span  = top - base;
+        cw.shift = shift;
+        cw.cells.assign(static_cast<std::size_t>(cw.span >> shift) + 1, Cell{});
+        std::size_t b = 0;  // bin at the start of the current cell
+        for (std::size_t c = 0; c < cw.cells.size(); ++c) {
+            const long long first = base + (static_cast<long long>(c) << shift);
+            const long long last  = first + (1LL << shift) - 1;
+            while (b < edges.size() && edges[b] <= first) ++b;
+            auto& cell = cw.cells[c];
+            cell.bin = static_cast<std::uint16_t>(b);
+            if (b < edges.size() && edges[b] <= last) {
+                cell.edge = edges[b];
+                std::size_t e = b;
+                while (e < edges.size() && edges[e] == cell.edge) ++e;
+                cell.jump = static_cast<std::uint16_t>(e - b);
+            }
+        }
+    }
+
+    static std::int32_t quantize(double v, double scale) {
+        return static_cast<std::int32_t>(std::llround(v * scale));
+    }
+};
+
+} // namespace vj
+
+#endif // COMPILED_CASCADE_HPP
@@ -0,0 +1,328 @@
+#ifndef DETECTOR_HPP
+#define DETECTOR_HPP
+
+#include "CascadeClassifier.h"
+#include "CompiledCascade.h"
+#include "Grouping.h"
+#include "Image.h"
+#include "Luma.h"
+#include "Trace.h"
+#include <vector>
+#include <string>
+#include <numeric>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <exception>
+
+// multi-scale sliding window detector: image pyramid + integral image per
+// level + cascade on every window + grouping of the raw hits
+// (what used to live inline in main.cpp, shared by main and the server).
+// windows are evaluated with the fixed-point CompiledCascade.
+//
+// several models (cascades, possibly trained on different window sizes) can
+// share one detector: the pyramid and its integral images are built once per
+// frame and every model is evaluated in the same sweep over each level
+//
+// tiled mode (ScanParams::tiled) is for big frames: every level is cut into
+// tiles whose 32-bit integral image fits the cache budget, each with a halo
+// of one window on the right/bottom so the windows starting in a tile fit in
+// it. a window belongs to the tile its origin (on the level step grid) is in,
+// so the seams give no duplicates and the raw hits are the same as untiled.
+// tiles are scanned on the calling thread, or in parallel on tile_threads
+// threads of its own for a caller that has the cores to itself
+
+namespace vj {
+
+struct ScanParams {
+    int    base_window_size = 24;   // cascade was trained on this size
+    double scale_factor     = 1.3;
+    int    min_neighbors    = 2;
+    double group_eps        = 0.2;
+    bool   group_weights    = false; // weight hits by cascade score when grouping, instead of counting them
+    int    max_scales       = 10;
+    int    step_ratio       = 4;    // step = window / step_ratio
+    double min_scale        = 1.0;  // i.e. dont lower the resolution
+    double max_scale        = 10.0; // maximum scale
+    double min_face_ratio   = 0.05; // of the frame height
+    double max_face_ratio   = 0.8;
+    bool        tiled            = false;       // cache-sized tiles, scanned in parallel
+    std::size_t tile_cache_bytes = 256 * 1024;  // per tile integral image, roughly L2
+    unsigned    tile_threads     = 1;           // threads per detect(), 0 = one per hardware thread.
+                                                // keep 1 when detect() already runs on a worker pool
+};
+
+// one cascade + the window size it was trained on
+template<typename T>
+struct Model {
+    CascadeClassifier<T> cascade;
+    int                  window_size = 24;
+    std::string          name;
+};
+
+template<typename T>
+class Detector {
+public:
+    explicit Detector(CascadeClassifier<T> cascade, ScanParams params = {})
+      : params_(params)
+    {
+        addModel({ std::move(cascade), params.base_window_size, "" });
+    }
+
+    explicit Detector(std::vector<Model<T>> models, ScanParams params = {})
+      : params_(params)
+    {
+        for (auto& m : models) addModel(std::move(m));
+    }
+
+    const ScanParams& params() const { return params_; }
+    const std::vector<Model<T>>& models() const { return models_; }
+
+    // first model, for the single cascade case
+    const CascadeClassifier<T>& cascade() const { return models_.front().cascade; }
+    const CompiledCascade<T>&   compiled(std::size_t model = 0) const { return compiled_[model]; }
+
+    // whole frame
+    std::vector<Detection> detect(const LumaView& frame) const {
+        return detect(frame, { 0, 0, static_cast<int>(frame.width), static_cast<int>(frame.height) });
+    }
+
+    // only windows inside `roi`, boxes come back in frame coordinates
+    // and tagged with the index of the model that found them
+    std::vector<Detection> detect(const LumaView& frame, Rect<int> roi) const
+    {
+        VJ_TRACE_SCOPE("detect");
+
+        // store detections at each scale, per model
+        std::vector<std::vector<Detection>> raw_detections(models_.size());
+        if (params_.tiled) {
+            raw_detections = scanTiled(frame, roi);
+        } else {
+            scan(frame, roi, [&](const Level& lv, const Image<long long>& I, int x, int y) {
+                if (compiled_[lv.model].classify(I, x, y))
+                    raw_detections[lv.model].push_back({ lv.toFrame(x, y), weight(lv, I, x, y), lv.model });
+            });
+        }
+
+        // we perform non-maximum suppression to merge overlapping detections
+        // (never across models)
+        VJ_TRACE_SCOPE("group");
+        std::vector<Detection> out;
+        for (auto const& raw : raw_detections) {
+            auto groups = groupDetections(raw, {params_.min_neighbors, params_.group_eps, params_.group_weights});
+            out.insert(out.end(), groups.begin(), groups.end());
+        }
+        return out;
+    }
+
+    // one model on one pyramid level: frame (roi) shrunk by `ratio`, a
+    // window of the model there covers `size` x `size` frame pixels
+    struct Level {
+        Rect<int>   roi;
+        double      ratio;
+        int         size;
+        std::size_t model  = 0;
+        int         window = 24;
+        int         step   = 6;
+
+        Rect<int> toFrame(int x, int y) const {
+            return { roi.x + static_cast<int>(std::lround(x / ratio)),
+                     roi.y + static_cast<int>(std::lround(y / ratio)),
+                     size, size };
+        }
+    };
+
+    // the sliding window sweep itself: calls fn(level, integral, x, y) for
+    // every window position of every model on every pyramid level. every
+    // level is read straight from the luma bytes, once for all models
+    template<typename Fn>
+    void scan(const LumaView& frame, Rect<int> roi, Fn&& fn) const
+    {
+        forEachLevel(frame, roi, [&](const Rect<int>& level_roi, double ratio, const std::vector<Level>& active) {
+            // integral image of this level in the pyramid, shared by all models
+            auto I = [&] {
+                VJ_TRACE_SCOPE("pyramid level");
+                return integralImage(frame, level_roi, ratio);
+            }();
+            const int scaled_W = static_cast<int>(I.width());
+            const int scaled_H = static_cast<int>(I.height());
+
+            // one sweep on the common step grid, each model on its own step
+            const int step = commonStep(active);
+
+            // scan with sliding window
+            VJ_TRACE_SCOPE("scan level");
+            for (int y = 0; y + min_window_ <= scaled_H; y += step) {
+                for (int x = 0; x + min_window_ <= scaled_W; x += step) {
+                    for (auto const& lv : active) {
+                        if (x % lv.step == 0 && y % lv.step == 0 &&
+                            x + lv.window <= scaled_W && y + lv.window <= scaled_H)
+                            fn(lv, I, x, y);
+                    }
+                }
+            }
+        });
+    }
+
+private:
+    std::vector<Model<T>>            models_;
+    std::vector<CompiledCascade<T>>  compiled_;  // what the window loop actually runs
+    ScanParams                       params_;
+    int                              min_window_ = 0;
+
+    // weight of a raw hit: its score when grouping by weight, else 1 (plain count)
+    template<typename S>
+    double weight(const Level& lv, const Image<S>& I, int x, int y) const {
+        return params_.group_weights ? compiled_[lv.model].score(I, x, y) : 1.0;
+    }
+
+    static int commonStep(const std::vector<Level>& active) {
+        int step = active.front().step;
+        for (auto const& lv : active) step = std::gcd(step, lv.step);
+        return step;
+    }
+
+    // the pyramid: calls fn(roi, ratio, models active on the level) per level
+    template<typename Fn>
+    void forEachLevel(const LumaView& frame, Rect<int> roi, Fn&& fn) const
+    {
+        auto const& p = params_;
+
+        // keep the roi inside the frame
+        const int fw = static_cast<int>(frame.width), fh = static_cast<int>(frame.height);
+        int x0 = std::clamp(roi.x, 0, fw), y0 = std::clamp(roi.y, 0, fh);
+        int x1 = std::clamp(roi.x + roi.w, x0, fw), y1 = std::clamp(roi.y + roi.h, y0, fh);
+        roi = { x0, y0, x1 - x0, y1 - y0 };
+        if (roi.w < min_window_ || roi.h < min_window_)
+            return;
+
+        const int H = roi.h;
+
+        // pre-calculate min/max face sizes
+        int min_face_size = static_cast<int>(H * p.min_face_ratio);
+        int max_face_size = static_cast<int>(H * p.max_face_ratio);
+
+        double scale = p.min_scale;
+
+        // limit total number of scales to process
+        int scales_processed = 0;
+
+        std::vector<Level> active;
+        while (scales_processed < p.max_scales && scale <= p.max_scale) {
+            // current detection size at this scale (for the base window)
+            int current_size = static_cast<int>(std::lround(p.base_window_size * scale));
+            double ratio = p.base_window_size / static_cast<double>(current_size);
+
+            // models whose objects at this scale are in our target size range
+            active.clear();
+            for (std::size_t m = 0; m < models_.size(); ++m) {
+                int win = models_[m].window_size;
+                int size = static_cast<int>(std::lround(win / ratio));
+                if (size >= min_face_size && size <= max_face_size)
+                    active.push_back({ roi, ratio, size, m, win, std::max(2, win / p.step_ratio) });
+            }
+            if (active.empty()) {
+                scale *= p.scale_factor;
+                continue;
+            }
+
+            scales_processed++;
+            fn(roi, ratio, active);
+
+            // move to next scale
+            scale *= p.scale_factor;
+        }
+    }
+
+    // tiled sweep, raw hits per model
+    std::vector<std::vector<Detection>> scanTiled(const LumaView& frame, Rect<int> roi) const
+    {
+        struct Tile {
+            Rect<int>          roi;     // frame roi of the level
+            double             ratio;
+            std::size_t        level;   // into `levels`
+            Rect<int>          core;    // window origins owned by this tile, level pixels
+            Rect<int>          pixels;  // core + halo, what the integral image covers
+        };
+        std::vector<std::vector<Level>> levels;
+        std::vector<Tile> tiles;
+
+        // largest square 32-bit integral image within the cache budget
+        const int edge = std::max(1, static_cast<int>(std::sqrt(params_.tile_cache_bytes / sizeof(std::uint32_t))));
+
+        forEachLevel(frame, roi, [&](const Rect<int>& level_roi, double ratio, const std::vector<Level>& active) {
+            auto [W, H] = levelSize(level_roi, ratio);
+            const int step = commonStep(active);
+            int halo = 0;
+            for (auto const& lv : active) halo = std::max(halo, lv.window - 1);
+            // core on the step grid, so every tile starts on it
+            const int core = std::max(step, (edge - halo) / step * step);
+            for (int cy = 0; cy + min_window_ <= H; cy += core) {
+                for (int cx = 0; cx + min_window_ <= W; cx += core) {
+                    Rect<int> c{ cx, cy, std::min(core, W - cx), std::min(core, H - cy) };
+                    Rect<int> px{ cx, cy, std::min(core + halo, W - cx), std::min(core + halo, H - cy) };
+                    tiles.push_back({ level_roi, ratio, levels.size(), c, px });
+                }
+            }
+            levels.push_back(active);
+        });
+
+        unsigned n = params_.tile_threads ? params_.tile_threads : std::thread::hardware_concurrency();
+        n = static_cast<unsigned>(std::clamp<std::size_t>(n, 1, std::max<std::size_t>(1, tiles.size())));
+
+        std::vector<std::vector<std::vector<Detection>>> found(n, std::vector<std::vector<Detection>>(models_.size()));
+        std::vector<std::exception_ptr> errors(n);
+        std::atomic<std::size_t> next{0};
+
+        auto work = [&](unsigned t) {
+            try {
+                for (std::size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < tiles.size();) {
+                    VJ_TRACE_SCOPE("tile");
+                    auto const& tile = tiles[i];
+                    auto const& active = levels[tile.level];
+                    auto [W, H] = levelSize(tile.roi, tile.ratio);
+                    auto I = integralTile<std::uint32_t>(frame, tile.roi, tile.ratio, tile.pixels);
+                    const int step = commonStep(active);
+                    for (int y = tile.core.y; y < tile.core.y + tile.core.h; y += step) {
+                        for (int x = tile.core.x; x < tile.core.x + tile.core.w; x += step) {
+                            for (auto const& lv : active) {
+                                if (x % lv.step == 0 && y % lv.step == 0 &&
+                                    x + lv.window <= W && y + lv.window <= H &&
+                                    compiled_[lv.model].classify(I, x - tile.pixels.x, y - tile.pixels.y))
+                                    found[t][lv.model].push_back({ lv.toFrame(x, y),
+                                                                   weight(lv, I, x - tile.pixels.x, y - tile.pixels.y),
+                                                                   lv.model });
+                            }
+                        }
+                    }
+                }
+            } catch (...) {
+                errors[t] = std::current_exception();
+            }
+        };
+        std::vector<std::thread> pool;
+        for (unsigned t = 1; t < n; ++t) pool.emplace_back(work, t);
+        work(0);
+        for (auto& th : pool) th.join();
+        for (auto const& e : errors)
+            if (e) std::rethrow_exception(e);
+
+        std::vector<std::vector<Detection>> raw(models_.size());
+        for (auto& per_thread : found)
+            for (std::size_t m = 0; m < raw.size(); ++m)
+                raw[m].insert(raw[m].end(), per_thread[m].begin(), per_thread[m].end());
+        return raw;
+    }
+
+    void addModel(Model<T> m) {
+        compiled_.emplace_back(m.cascade);
+        min_window_ = models_.empty() ? m.window_size : std::min(min_window_, m.window_size);
+        models_.push_back(std::move(m));
+    }
+};
+
+} // namespace vj
+
+#endif // DETECTOR_HPP
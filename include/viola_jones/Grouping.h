@@ -0,0 +1,199 @@
+#ifndef GROUPING_HPP
+#define GROUPING_HPP
+
+#include "HaarFeature.h"
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#include <numeric>
+#include <unordered_map>
+#include <map>
+#include <utility>
+
+// grouping of raw sliding-window hits into final detections
+// same semantics as cv::groupRectangles (same similarity predicate,
+// "more than min_neighbors" rule and nested-box suppression), but the
+// clustering buckets hits on a spatial grid per window size, so each hit is
+// only compared with hits in neighbouring cells of compatible sizes
+// instead of with every other hit
+
+namespace vj {
+
+struct Detection {
+    Rect<int>   box;
+    double      weight = 1.0;  // e.g. cascade depth or score, 1 = plain count
+    std::size_t model  = 0;    // which cascade found it (multi-model detection)
+};
+
+struct GroupingOptions {
+    int    min_neighbors = 2;      // clusters with <= min_neighbors hits are dropped
+    double eps           = 0.2;    // relative similarity tolerance (as in OpenCV)
+    bool   use_weights   = false;  // weight-average boxes by Detection::weight
+};
+
+namespace detail {
+
+// plain union-find with path halving
+class DisjointSets {
+public:
+    explicit DisjointSets(std::size_t n) : parent_(n) {
+        std::iota(parent_.begin(), parent_.end(), std::size_t{0});
+    }
+    std::size_t find(std::size_t i) {
+        while (parent_[i] != i) {
+            parent_[i] = parent_[parent_[i]];
+            i = parent_[i];
+        }
+        return i;
+    }
+    void unite(std::size_t a, std::size_t b) {
+        a = find(a); b = find(b);
+        if (a != b) parent_[std::max(a, b)] = std::min(a, b);
+    }
+private:
+    std::vector<std::size_t> parent_;
+};
+
+// the predicate used by cv::groupRectangles (SimilarRects)
+inline bool similarRects(const Rect<int>& a, const Rect<int>& b, double eps) {
+    double delta = eps * (std::min(a.w, b.w) + std::min(a.h, b.h)) * 0.5;
+    return std::abs(a.x - b.x) <= delta &&
+           std::abs(a.y - b.y) <= delta &&
+           std::abs(a.x + a.w - b.x - b.w) <= delta &&
+           std::abs(a.y + a.h - b.y - b.h) <= delta;
+}
+
+inline std::uint64_t cellKey(int cx, int cy) {
+    return (static_cast<std::uint64_t>(static_cast<std::uint32_t>(cx)) << 32)
+         | static_cast<std::uint32_t>(cy);
+}
+
+inline int floorDiv(int a, int b) {
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+} // namespace detail
+
+// clusters `dets` and returns the surviving groups, with `weight` set to the
+// number of hits (or the summed weights when opts.use_weights is set).
+// expects hits of one model, group each model separately
+inline std::vector<Detection>
+groupDetections(const std::vector<Detection>& dets, const GroupingOptions& opts = {})
+{
+    // OpenCV returns the input untouched in this case, keep that
+    if (opts.min_neighbors <= 0 || dets.empty())
+        return dets;
+
+    const double eps = opts.eps;
+
+    // 1) one grid per window size (= per pyramid level). the cell is at least
+    //    as large as any similarity delta a box of that size can take part in,
+    //    so similar boxes are always in the same or an adjacent cell
+    struct Level {
+        int w, h, cell;
+        std::unordered_map<std::uint64_t, std::vector<std::size_t>> grid;
+    };
+    std::map<std::pair<int,int>, std::size_t> levelOf;
+    std::vector<Level> levels;
+    std::vector<std::size_t> levelIdx(dets.size());
+    for (std::size_t i = 0; i < dets.size(); ++i) {
+        auto const& r = dets[i].box;
+        auto [it, inserted] = levelOf.try_emplace({r.w, r.h}, levels.size());
+        if (inserted) {
+            int cell = std::max(1, static_cast<int>(std::ceil(eps * std::max(r.w, r.h))));
+            levels.push_back({r.w, r.h, cell, {}});
+        }
+        auto& L = levels[it->second];
+        levelIdx[i] = it->second;
+        L.grid[detail::cellKey(detail::floorDiv(r.x, L.cell),
+                               detail::floorDiv(r.y, L.cell))].push_back(i);
+    }
+
+    // 2) for every level, the levels whose sizes are close enough to ever
+    //    satisfy the predicate (both edges within delta => |w1-w2| <= 2*delta)
+    std::vector<std::vector<std::size_t>> partners(levels.size());
+    for (std::size_t a = 0; a < levels.size(); ++a) {
+        for (std::size_t b = a; b < levels.size(); ++b) {
+            double delta = eps * (std::min(levels[a].w, levels[b].w)
+                                + std::min(levels[a].h, levels[b].h)) * 0.5;
+            if (std::abs(levels[a].w - levels[b].w) <= 2 * delta &&
+                std::abs(levels[a].h - levels[b].h) <= 2 * delta)
+                partners[a].push_back(b);
+        }
+    }
+
+    // 3) union every hit with its similar neighbours
+    detail::DisjointSets sets(dets.size());
+    for (std::size_t i = 0; i < dets.size(); ++i) {
+        auto const& r = dets[i].box;
+        for (auto b : partners[levelIdx[i]]) {
+            auto const& L = levels[b];
+            int cx = detail::floorDiv(r.x, L.cell), cy = detail::floorDiv(r.y, L.cell);
+            for (int dy = -1; dy <= 1; ++dy) {
+                for (int dx = -1; dx <= 1; ++dx) {
+                    auto it = L.grid.find(detail::cellKey(cx + dx, cy + dy));
+                    if (it == L.grid.end()) continue;
+                    for (auto j : it->second) {
+                        if (j != i && detail::similarRects(r, dets[j].box, eps))
+                            sets.unite(i, j);
+                    }
+                }
+            }
+        }
+    }
+
+    // 4) average each cluster
+    struct Cluster { double x = 0, y = 0, w = 0, h = 0, mass = 0; int n = 0; std::size_t model = 0; };
+    std::unordered_map<std::size_t, std::size_t> clusterOf;
+    std::vector<Cluster> clusters;
+    for (std::size_t i = 0; i < dets.size(); ++i) {
+        auto [it, inserted] = clusterOf.try_emplace(sets.find(i), clusters.size());
+        if (inserted) clusters.push_back({ .model = dets[i].model });
+        auto& c = clusters[it->second];
+        double m = opts.use_weights ? dets[i].weight : 1.0;
+        auto const& r = dets[i].box;
+        c.x += m * r.x; c.y += m * r.y; c.w += m * r.w; c.h += m * r.h;
+        c.mass += m;
+        c.n++;
+    }
+
+    std::vector<Detection> groups;
+    std::vector<int> counts;
+    for (auto const& c : clusters) {
+        if (c.n <= opts.min_neighbors || c.mass <= 0) continue;
+        double s = 1.0 / c.mass;
+        Rect<int> r{ static_cast<int>(std::lround(c.x * s)), static_cast<int>(std::lround(c.y * s)),
+                     static_cast<int>(std::lround(c.w * s)), static_cast<int>(std::lround(c.h * s)) };
+        groups.push_back({ r, opts.use_weights ? c.mass : static_cast<double>(c.n), c.model });
+        counts.push_back(c.n);
+    }
+
+    // 5) drop small groups sitting inside a stronger big one (as OpenCV does).
+    //    this is quadratic in the number of *groups*, which stays small
+    std::vector<Detection> out;
+    for (std::size_t i = 0; i < groups.size(); ++i) {
+        auto const& r1 = groups[i].box;
+        int n1 = counts[i];
+        bool nested = false;
+        for (std::size_t j = 0; j < groups.size() && !nested; ++j) {
+            if (j == i) continue;
+            auto const& r2 = groups[j].box;
+            int n2 = counts[j];
+            int dx = static_cast<int>(std::lround(r2.w * eps));
+            int dy = static_cast<int>(std::lround(r2.h * eps));
+            nested = r1.x >= r2.x - dx && r1.y >= r2.y - dy &&
+                     r1.x + r1.w <= r2.x + r2.w + dx &&
+                     r1.y + r1.h <= r2.y + r2.h + dy &&
+                     (n2 > std::max(3, n1) || n1 < 3);
+        }
+        if (!nested) out.push_back(groups[i]);
+    }
+    return out;
+}
+
+} // namespace vj
+
+#endif // GROUPING_HPP
@@ -17,14 +17,20 @@ public:
     HaarFeature(Rect<T> white, Rect<T> black)
       : white_(white), black_(black) {}
 
-    // evaluate at offset (ox,oy) on an integral image
-    long long operator()(const Image<long long>& I,
+    // evaluate at offset (ox,oy) on an integral image. S can be a 32-bit
+    // unsigned type: corner sums wrap, but a rect sum is exact as long as it
+    // fits (always true for a window of 8-bit pixels)
+    template<typename S>
+    long long operator()(const Image<S>& I,
                          std::size_t ox, std::size_t oy) const
     {
         return rectSum(I, white_, ox,oy)
              - rectSum(I, black_, ox,oy);
     }
 
+    const Rect<T>& white() const { return white_; }
+    const Rect<T>& black() const { return black_; }
+
     // serialization
     void save(std::ostream& os) const {
       // write white rect then black rect
@@ -45,7 +51,8 @@ public:
 private:
     Rect<T> white_, black_;
 
-    static long long rectSum(const Image<long long>& I,
+    template<typename S>
+    static long long rectSum(const Image<S>& I,
                              Rect<T> r, std::size_t ox, std::size_t oy)
     {
         std::size_t x1 = ox + static_cast<std::size_t>(r.x);
@@ -55,12 +62,12 @@ private:
         if (x2 >= I.width() || y2 >= I.height())
             throw std::out_of_range("HaarFeature out of bounds");
 
-        auto A = (x1>0 && y1>0) ? I[y1-1][x1-1] : 0LL;
-        auto B = (y1>0) ? I[y1-1][x2] : 0LL;
-        auto C = (x1>0) ? I[y2][x1-1] : 0LL;
-        auto D = I[y2][x2];
+        S A = (x1>0 && y1>0) ? I[y1-1][x1-1] : S{0};
+        S B = (y1>0) ? I[y1-1][x2] : S{0};
+        S C = (x1>0) ? I[y2][x1-1] : S{0};
+        S D = I[y2][x2];
 
-        return D + A - B - C;
+        return static_cast<long long>(static_cast<S>(D + A - B - C));
     }
 };
 
@@ -0,0 +1,77 @@
+#ifndef LATEST_FRAME_RING_HPP
+#define LATEST_FRAME_RING_HPP
+
+#include <array>
+#include <atomic>
+
+// single-producer / single-consumer hand-off where the newest value wins
+//
+// three slots: the producer owns one, the consumer owns one and the third one
+// sits "in the middle". publishing swaps the producer slot with the middle one,
+// acquiring swaps the consumer slot with the middle one, both with a single
+// atomic exchange, so neither side ever blocks the other. if the producer
+// publishes twice before the consumer looks, the older value is simply
+// overwritten, which is exactly what we want for camera frames
+
+namespace vj {
+
+template<typename T>
+class LatestFrameRing {
+public:
+    // producer side: fill writeSlot() then publish() it
+    T& writeSlot() { return slots_[back_]; }
+
+    void publish() {
+        back_ = middle_.exchange(back_ | kFresh, std::memory_order_acq_rel) & kIndex;
+        middle_.notify_one();
+    }
+
+    // no more values will be published (producer only), wakes up a waiting consumer
+    void close() {
+        middle_.fetch_or(kClosed, std::memory_order_release);
+        middle_.notify_one();
+    }
+
+    // consumer side: swap in the newest value if there is one
+    // returns false when nothing new was published since the last call
+    bool acquire() {
+        unsigned m = middle_.load(std::memory_order_acquire);
+        while (m & kFresh) {
+            // keep the closed flag, hand our slot back as the stale middle one
+            if (middle_.compare_exchange_weak(m, front_ | (m & kClosed),
+                                              std::memory_order_acq_rel,
+                                              std::memory_order_acquire)) {
+                front_ = m & kIndex;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // blocks until a new value is available (true) or the ring is closed (false)
+    bool waitAcquire() {
+        for (;;) {
+            unsigned m = middle_.load(std::memory_order_acquire);
+            if (m & kFresh) return acquire();
+            if (m & kClosed) return false;
+            middle_.wait(m, std::memory_order_acquire);
+        }
+    }
+
+    const T& readSlot() const { return slots_[front_]; }
+    T&       readSlot()       { return slots_[front_]; }
+
+private:
+    static constexpr unsigned kIndex  = 0x3;
+    static constexpr unsigned kFresh  = 0x4;
+    static constexpr unsigned kClosed = 0x8;
+
+    std::array<T, 3>      slots_{};
+    std::atomic<unsigned> middle_{1};
+    unsigned              back_  = 0;  // owned by the producer
+    unsigned              front_ = 2;  // owned by the consumer
+};
+
+} // namespace vj
+
+#endif // LATEST_FRAME_RING_HPP
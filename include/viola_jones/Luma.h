@@ -0,0 +1,128 @@
+#ifndef LUMA_HPP
+#define LUMA_HPP
+
+#include "Image.h"
+#include "HaarFeature.h"
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <utility>
+
+// detector input straight from the luma plane of a decoded frame, without
+// converting it to a cv::Mat or a vj::Image first. the integral image of a
+// pyramid level is built directly from the (strided) source bytes
+
+namespace vj {
+
+// non-owning view of 8-bit luma samples
+struct LumaView {
+    const std::uint8_t* data   = nullptr;
+    std::size_t         width  = 0;
+    std::size_t         height = 0;
+    std::size_t         stride = 0;  // bytes between rows
+    std::size_t         step   = 1;  // bytes between samples (2 for packed YUYV)
+
+    std::uint8_t operator()(std::size_t x, std::size_t y) const {
+        return data[y * stride + x * step];
+    }
+
+    // NV12 / I420 / plain gray: Y is its own plane
+    static LumaView planar(const std::uint8_t* y, std::size_t w, std::size_t h, std::size_t stride) {
+        return { y, w, h, stride, 1 };
+    }
+    // YUYV (YUY2): Y0 U Y1 V, luma on every other byte
+    static LumaView yuyv(const std::uint8_t* p, std::size_t w, std::size_t h, std::size_t stride) {
+        return { p, w, h, stride, 2 };
+    }
+};
+
+// size of `roi` resampled by `ratio`, i.e. of its pyramid level
+inline std::pair<int, int> levelSize(const Rect<int>& roi, double ratio) {
+    if (ratio == 1.0) return { roi.w, roi.h };
+    return { std::max(1, static_cast<int>(std::lround(roi.w * ratio))),
+             std::max(1, static_cast<int>(std::lround(roi.h * ratio))) };
+}
+
+// integral image of the part `tile` (in level pixels) of the pyramid level
+// of `roi` of `src` resampled by `ratio` (<= 1 shrinks). resampling is
+// bilinear with the same pixel-centre mapping and 11-bit fixed-point weights
+// as cv::resize(INTER_LINEAR), fused into the integral pass. a tile gets the
+// same pixels as the corresponding part of the whole level.
+// with S = uint32_t the sums wrap on big tiles, see HaarFeature
+template<typename S>
+Image<S> integralTile(const LumaView& src, const Rect<int>& roi, double ratio, const Rect<int>& tile)
+{
+    const auto rx = static_cast<std::size_t>(roi.x), ry = static_cast<std::size_t>(roi.y);
+    const int rw = roi.w, rh = roi.h;
+    const int W = tile.w, H = tile.h;
+
+    Image<S> I(W, H);
+    if (ratio == 1.0) {
+        for (int y = 0; y < H; ++y) {
+            const std::uint8_t* row = src.data + (ry + tile.y + y) * src.stride + (rx + tile.x) * src.step;
+            S row_sum = 0;
+            for (int x = 0; x < W; ++x) {
+                row_sum += row[x * src.step];
+                I[y][x] = row_sum + (y > 0 ? I[y-1][x] : S{0});
+            }
+        }
+        return I;
+    }
+
+    constexpr int kBits = 11, kOne = 1 << kBits;
+
+    // source index + weight of the right/bottom neighbour, per output column/row
+    auto taps = [&](int first, int n_out, int n_src, std::vector<int>& idx, std::vector<int>& frac) {
+        idx.resize(n_out); frac.resize(n_out);
+        const double inv = 1.0 / ratio;
+        for (int i = 0; i < n_out; ++i) {
+            double f = (first + i + 0.5) * inv - 0.5;
+            int s = static_cast<int>(std::floor(f));
+            double t = f - s;
+            if (s < 0) { s = 0; t = 0; }
+            if (s >= n_src - 1) { s = n_src - 1; t = 0; }
+            idx[i] = s;
+            frac[i] = static_cast<int>(std::lround(t * kOne));
+        }
+    };
+    std::vector<int> xs, xf, ys, yf;
+    taps(tile.x, W, rw, xs, xf);
+    taps(tile.y, H, rh, ys, yf);
+
+    for (int y = 0; y < H; ++y) {
+        const int y0 = ys[y], y1 = std::min(y0 + 1, rh - 1);
+        const std::uint8_t* r0 = src.data + (ry + y0) * src.stride + rx * src.step;
+        const std::uint8_t* r1 = src.data + (ry + y1) * src.stride + rx * src.step;
+        const int fy = yf[y];
+        S row_sum = 0;
+        for (int x = 0; x < W; ++x) {
+            const std::size_t x0 = static_cast<std::size_t>(xs[x]) * src.step;
+            const std::size_t x1 = static_cast<std::size_t>(std::min(xs[x] + 1, rw - 1)) * src.step;
+            const int fx = xf[x];
+            int top = r0[x0] * (kOne - fx) + r0[x1] * fx;
+            int bot = r1[x0] * (kOne - fx) + r1[x1] * fx;
+            int v = (top * (kOne - fy) + bot * fy + (1 << (2*kBits - 1))) >> (2*kBits);
+            row_sum += static_cast<S>(v);
+            I[y][x] = row_sum + (y > 0 ? I[y-1][x] : S{0});
+        }
+    }
+    return I;
+}
+
+// integral image of the whole pyramid level of `roi`
+inline Image<long long>
+integralImage(const LumaView& src, const Rect<int>& roi, double ratio = 1.0)
+{
+    auto [W, H] = levelSize(roi, ratio);
+    return integralTile<long long>(src, roi, ratio, { 0, 0, W, H });
+}
+
+inline Image<long long> integralImage(const LumaView& src, double ratio = 1.0) {
+    return integralImage(src, { 0, 0, static_cast<int>(src.width), static_cast<int>(src.height) }, ratio);
+}
+
+} // namespace vj
+
+#endif // LUMA_HPP
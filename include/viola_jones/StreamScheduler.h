@@ -0,0 +1,147 @@
+#ifndef STREAM_SCHEDULER_HPP
+#define STREAM_SCHEDULER_HPP
+
+#include <vector>
+#include <optional>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <mutex>
+#include <condition_variable>
+
+// shares one worker pool between many frame sources (cameras, replayed files):
+//   - every stream has a single pending slot, a new frame replaces a frame
+//     that was not picked up yet (latest frame wins, per stream)
+//   - workers take pending frames round-robin over the streams, so a fast
+//     or bursty stream can not starve the others
+//   - a frame older than its stream's deadline when a worker gets to it is
+//     dropped instead of processed: its result would be too late anyway
+// per-stream counters give fps, drops and glass-to-result latency
+
+namespace vj {
+
+template<typename Frame>
+class StreamScheduler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Job {
+        std::size_t       stream = 0;
+        std::uint64_t     seq = 0;
+        Frame             frame;
+        Clock::time_point captured;
+    };
+
+    struct StreamStats {
+        std::uint64_t   submitted = 0;
+        std::uint64_t   processed = 0;
+        std::uint64_t   replaced  = 0;  // overwritten by a newer frame before anyone took it
+        std::uint64_t   expired   = 0;  // dropped, older than the deadline when picked up
+        std::uint64_t   late      = 0;  // processed, but finished after the deadline
+        Clock::duration latency_sum{};
+        Clock::duration latency_max{};
+
+        double meanLatencyMs() const {
+            return processed ? std::chrono::duration<double, std::milli>(latency_sum).count() / processed : 0;
+        }
+        double maxLatencyMs() const {
+            return std::chrono::duration<double, std::milli>(latency_max).count();
+        }
+    };
+
+    StreamScheduler(std::size_t streams, Clock::duration deadline)
+      : streams_(streams)
+    {
+        for (auto& s : streams_) s.deadline = deadline;
+    }
+
+    std::size_t streams() const { return streams_.size(); }
+
+    void setDeadline(std::size_t stream, Clock::duration deadline) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        streams_[stream].deadline = deadline;
+    }
+
+    // producer side, never blocks on the workers
+    void submit(std::size_t stream, Frame frame, Clock::time_point captured = Clock::now()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto& s = streams_[stream];
+            s.stats.submitted++;
+            if (s.pending) s.stats.replaced++;
+            s.pending = Job{ stream, s.next_seq++, std::move(frame), captured };
+        }
+        ready_.notify_one();
+    }
+
+    // worker side: blocks until some stream has a frame still within its
+    // deadline (or the scheduler is closed). nullopt = closed
+    std::optional<Job> next() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (;;) {
+            if (closed_) return std::nullopt;
+            const auto now = Clock::now();
+            const std::size_t n = streams_.size();
+            for (std::size_t i = 0; i < n; ++i) {
+                auto& s = streams_[(cursor_ + i) % n];
+                if (!s.pending) continue;
+                if (now - s.pending->captured > s.deadline) {
+                    s.stats.expired++;
+                    s.pending.reset();
+                    continue;
+                }
+                Job job = std::move(*s.pending);
+                s.pending.reset();
+                cursor_ = (job.stream + 1) % n;  // next search starts after this stream
+                return job;
+            }
+            ready_.wait(lock);
+        }
+    }
+
+    // worker side: the result of `job` is ready
+    void done(const Job& job, Clock::time_point finished = Clock::now()) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& s = streams_[job.stream];
+        auto latency = finished - job.captured;
+        s.stats.processed++;
+        s.stats.latency_sum += latency;
+        s.stats.latency_max = std::max(s.stats.latency_max, latency);
+        if (latency > s.deadline) s.stats.late++;
+    }
+
+    // wakes every worker, next() returns nullopt from now on
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closed_ = true;
+        }
+        ready_.notify_all();
+    }
+
+    std::vector<StreamStats> stats() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<StreamStats> out;
+        for (auto const& s : streams_) out.push_back(s.stats);
+        return out;
+    }
+
+private:
+    struct Stream {
+        std::optional<Job> pending;
+        Clock::duration    deadline{};
+        std::uint64_t      next_seq = 0;
+        StreamStats        stats;
+    };
+
+    mutable std::mutex      mutex_;
+    std::condition_variable ready_;
+    std::vector<Stream>     streams_;
+    std::size_t             cursor_ = 0;
+    bool                    closed_ = false;
+};
+
+} // namespace vj
+
+#endif // STREAM_SCHEDULER_HPP
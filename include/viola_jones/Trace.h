@@ -0,0 +1,148 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+// timeline tracing, exported as Chrome trace JSON (chrome://tracing, Perfetto)
+//
+//   VJ_TRACE_SCOPE("scan");   // records one span from here to end of scope
+//
+// spans go into a per-thread buffer, no locking on the hot path. with
+// ENABLE_TRACING off (the default) the macro expands to nothing; with it on,
+// an untraced run costs one predictable branch per scope.
+// tracing is switched on at runtime by startFromEnv() when VJ_TRACE=<file>
+// is set, and finish() writes the file. call finish() once every traced
+// thread has been joined. in a build without tracing start() only warns and
+// finish() writes nothing
+
+namespace vj::trace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Event {
+    const char*   name;   // string literal
+    std::int64_t  begin;  // ns since trace start
+    std::int64_t  dur;    // ns
+};
+
+struct ThreadBuffer {
+    std::uint32_t      tid;
+    std::vector<Event> events;
+};
+
+struct State {
+    std::atomic<bool>                          enabled{false};
+    Clock::time_point                          origin = Clock::now();
+    std::string                                path;
+    std::mutex                                 mutex;   // guards buffers
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+};
+
+inline State& state() {
+    static State s;
+    return s;
+}
+
+inline bool enabled() {
+    return __builtin_expect(state().enabled.load(std::memory_order_relaxed), 0);
+}
+
+inline std::int64_t now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - state().origin).count();
+}
+
+// this thread's buffer, registered on first use
+inline ThreadBuffer& local() {
+    thread_local std::shared_ptr<ThreadBuffer> buf = [] {
+        auto& s = state();
+        std::lock_guard<std::mutex> lock(s.mutex);
+        auto b = std::make_shared<ThreadBuffer>();
+        b->tid = static_cast<std::uint32_t>(s.buffers.size() + 1);
+        b->events.reserve(1 << 14);
+        s.buffers.push_back(b);
+        return b;
+    }();
+    return *buf;
+}
+
+class Scope {
+public:
+    explicit Scope(const char* name) : name_(name) {
+        if (enabled()) begin_ = now();
+    }
+    ~Scope() {
+        if (begin_ >= 0) local().events.push_back({ name_, begin_, now() - begin_ });
+    }
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+private:
+    const char*  name_;
+    std::int64_t begin_ = -1;
+};
+
+inline void start(const std::string& path) {
+#ifdef VJ_ENABLE_TRACING
+    auto& s = state();
+    s.path = path;
+    s.origin = Clock::now();
+    s.enabled.store(true, std::memory_order_relaxed);
+#else
+    std::cerr << "warning: built without tracing (configure with -DENABLE_TRACING=ON), "
+              << path << " will not be written\n";
+#endif
+}
+
+// turns tracing on if VJ_TRACE=<output file> is set
+inline void startFromEnv() {
+    if (const char* p = std::getenv("VJ_TRACE"); p && *p)
+        start(p);
+}
+
+// writes every recorded span as a Chrome "complete" event.
+// false (and no file) if tracing was never started
+inline bool finish() {
+    auto& s = state();
+    if (!s.enabled.exchange(false))
+        return false;
+    std::ofstream out(s.path);
+    if (!out)
+        return false;
+    std::lock_guard<std::mutex> lock(s.mutex);
+    out << std::fixed << std::setprecision(3);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    for (auto const& b : s.buffers) {
+        for (auto const& e : b->events) {
+            out << (first ? "" : ",\n")
+                << "{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << b->tid
+                << ",\"ts\":" << e.begin / 1000.0 << ",\"dur\":" << e.dur / 1000.0 << "}";
+            first = false;
+        }
+    }
+    out << "\n]}\n";
+    return true;
+}
+
+} // namespace vj::trace
+
+#define VJ_TRACE_CONCAT_(a, b) a##b
+#define VJ_TRACE_CONCAT(a, b) VJ_TRACE_CONCAT_(a, b)
+
+#ifdef VJ_ENABLE_TRACING
+#define VJ_TRACE_SCOPE(name) ::vj::trace::Scope VJ_TRACE_CONCAT(vj_trace_scope_, __LINE__)(name)
+#else
+#define VJ_TRACE_SCOPE(name) ((void)0)
+#endif
+
+#endif // TRACE_HPP
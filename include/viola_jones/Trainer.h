@@ -12,11 +12,25 @@
 
 namespace vj {
 
+// Discrete: threshold stumps voting with weight alpha (the original paper)
+// Real / Gentle: confidence-rated lookup tables over binned feature values
+enum class Boosting { Discrete, Real, Gentle };
+
 struct TrainerOptions {
     std::size_t window_size = 24;
     std::size_t num_rounds   = 10;   // weak learners per stage
     double      target_FPR   = 0.5;  // false-positive rate per stage
     double      target_TPR   = 0.99; // detection rate per stage
+    std::size_t max_features = 5000; // features searched per round by trainCascade (trainStage searches all)
+    Boosting    boosting     = Boosting::Discrete;
+    std::size_t lut_bins     = 16;   // table size for Real/Gentle, 2..kMaxLutBins (256)
+
+    // per-round feature search on a subset (the weight update still uses every sample):
+    // weight trimming keeps the largest-weight samples holding trim_beta of the
+    // total weight, and neg_subsample > 0 draws that many negatives by weight
+    double      trim_beta     = 1.0;  // in (0, 1], 1 = no trimming, 0.99 is a usual value
+    std::size_t neg_subsample = 0;    // 0 = all negatives
+    unsigned    seed          = 1;
 };
 
 // progress callback type for tracking training progress
@@ -0,0 +1,60 @@
+#ifndef WORK_QUEUE_HPP
+#define WORK_QUEUE_HPP
+
+#include <deque>
+#include <optional>
+#include <cstddef>
+#include <mutex>
+#include <condition_variable>
+
+// multi-producer / multi-consumer FIFO for handing jobs to a worker pool.
+// consumers take one job at a time, so a burst is spread over every idle
+// worker instead of being run back to back by whoever woke up first
+
+namespace vj {
+
+template<typename T>
+class WorkQueue {
+public:
+    void push(T job) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            jobs_.push_back(std::move(job));
+        }
+        ready_.notify_one();
+    }
+
+    // blocks until a job is queued (or the queue is closed) and takes it.
+    // nullopt = closed and drained
+    std::optional<T> pop() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        ready_.wait(lock, [&]{ return closed_ || !jobs_.empty(); });
+        if (jobs_.empty()) return std::nullopt;
+        T job = std::move(jobs_.front());
+        jobs_.pop_front();
+        return job;
+    }
+
+    std::size_t size() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return jobs_.size();
+    }
+
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closed_ = true;
+        }
+        ready_.notify_all();
+    }
+
+private:
+    mutable std::mutex      mutex_;
+    std::condition_variable ready_;
+    std::deque<T>           jobs_;
+    bool                    closed_ = false;
+};
+
+} // namespace vj
+
+#endif // WORK_QUEUE_HPP
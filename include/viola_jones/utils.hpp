@@ -4,6 +4,15 @@
 #include <string>
 #include <opencv2/opencv.hpp>
 #include "viola_jones/Image.h"
+#include "viola_jones/Luma.h"
+
+// OpenCV adapter for the detector: view of an 8-bit single channel Mat
+// (no copy, the Mat must outlive the view)
+inline vj::LumaView lumaView(const cv::Mat& gray)
+{
+    return vj::LumaView::planar(gray.data, static_cast<std::size_t>(gray.cols),
+                                static_cast<std::size_t>(gray.rows), gray.step);
+}
 
 // we load all the images that match `glob_pattern` (e.g. "train/face/*.png") and then compute
 // their integral images and return as vj::Image<long long>
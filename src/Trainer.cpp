@@ -1,4 +1,5 @@
 #include "viola_jones/Trainer.h"
+#include "viola_jones/Trace.h"
 #include <algorithm>
 #include <limits>
 #include <cmath>
@@ -6,6 +7,8 @@
 #include <numeric>
 #include <functional>
 #include <iomanip>
+#include <random>
+#include <stdexcept>
 
 namespace vj {
 
@@ -46,21 +49,169 @@ makeAllHaarFeatures(std::size_t window_size)
       }
     }
 
-    std::cout << "Generated " << feats.size() << " Haar features for window size " << window_size << "x" << window_size << std::endl;
-    std::cout.flush();
+    std::cout << "Generated " << feats.size() << " Haar features for window size " << window_size << "x" << window_size << "\n";
     return feats;
 }
 
 
 
 
-// train a single AdaBoost stage
-AdaBoost<int>
-Trainer::trainStage(
-    const std::vector<Image<long long>>& posIs,
-    const std::vector<Image<long long>>& negIs,
-    const TrainerOptions& opts)
+// best stump for one feature: threshold + polarity minimizing the weighted error
+static void
+searchStump(const HaarFeature<int>& feat, const std::vector<double>& vals,
+            const std::vector<double>& w, std::size_t Npos,
+            double& bestErr, AdaBoost<int>::Weak& bestW)
+{
+    const std::size_t N = vals.size();
+    if (N == 0) return;
+
+    // sort to scan thresholds
+    std::vector<std::size_t> idx(N);
+    std::iota(idx.begin(), idx.end(), 0);
+    std::sort(idx.begin(), idx.end(),
+      [&](auto a, auto b){ return vals[a] < vals[b]; });
+
+    for (auto i : idx) {
+      // consider threshold at vals[i]
+      // for polarity = +1: predict positive if val < thresh
+      // error = sum weights where pred != label
+      double thr = vals[i];
+      for (int polarity : {+1, -1}) {
+        double err = 0;
+        for (std::size_t k = 0; k < N; ++k) {
+          bool pred = (polarity * vals[k] < polarity * thr);
+          if (pred != (k < Npos)) err += w[k];
+        }
+        if (err < bestErr) {
+          bestErr = err;
+          bestW = { feat, static_cast<int>(thr), polarity, 0.0, {} };
+        }
+      }
+    }
+}
+
+// best table for one feature (Real/Gentle AdaBoost): the responses are
+// binned over their range, every bin outputs a confidence from the weights
+// of the positives / negatives falling in it.
+// Real:   h = 1/2 ln(W+ / W-), score Z = 2 sum sqrt(W+ W-)
+// Gentle: h = (W+ - W-) / (W+ + W-), score = weighted squared error
+static void
+searchLut(const HaarFeature<int>& feat, const std::vector<double>& vals,
+          const std::vector<double>& w, std::size_t Npos, const TrainerOptions& opts,
+          double& bestScore, AdaBoost<int>::Weak& bestW)
 {
+    const std::size_t N = vals.size(), bins = opts.lut_bins;
+    if (N == 0) return;
+    auto [mn, mx] = std::minmax_element(vals.begin(), vals.end());
+    const double lo = *mn, hi = *mx + 1;  // values are integers, keep the largest inside
+
+    std::vector<double> wp(bins, 0), wn(bins, 0);
+    for (std::size_t k = 0; k < N; ++k) {
+      auto b = lutBin(static_cast<long long>(vals[k]), lo, hi, bins);
+      (k < Npos ? wp : wn)[b] += w[k];
+    }
+
+    // smoothing for empty bins
+    const double eps = 0.1 / static_cast<double>(N);
+    std::vector<double> lut(bins);
+    double score = 0;
+    for (std::size_t b = 0; b < bins; ++b) {
+      if (opts.boosting == Boosting::Real) {
+        lut[b] = 0.5 * std::log((wp[b] + eps) / (wn[b] + eps));
+        score += 2 * std::sqrt(wp[b] * wn[b]);
+      } else {
+        double total = wp[b] + wn[b];
+        lut[b] = total > 0 ? (wp[b] - wn[b]) / total : 0;
+        score += wp[b] * (1 - lut[b]) * (1 - lut[b]) + wn[b] * (1 + lut[b]) * (1 + lut[b]);
+      }
+    }
+    if (score < bestScore) {
+      bestScore = score;
+      bestW = { feat, 0, 1, 0.0, std::move(lut), lo, hi };
+    }
+}
+
+// picks the samples the feature search of a round looks at, positives first.
+// trimming drops the smallest weights holding at most 1 - trim_beta of the
+// mass; subsampling draws neg_subsample negatives with probability ~ weight,
+// each drawn sample standing for (times drawn) * (negative mass) / draws.
+// the picked weights are renormalized to sum to 1, like the full set.
+// returns how many of the picked samples are positives
+static std::size_t
+searchSubset(const std::vector<double>& w, std::size_t Npos, const TrainerOptions& opts,
+             std::mt19937& rng, std::vector<std::size_t>& act, std::vector<double>& aw)
+{
+    const std::size_t N = w.size();
+    std::vector<std::size_t> keep(N);
+    std::iota(keep.begin(), keep.end(), 0);
+
+    if (opts.trim_beta < 1.0) {
+      std::vector<std::size_t> byWeight = keep;
+      std::sort(byWeight.begin(), byWeight.end(), [&](auto a, auto b){ return w[a] > w[b]; });
+      double total = std::accumulate(w.begin(), w.end(), 0.0), mass = 0;
+      std::size_t n = 0;
+      while (n < N && mass < opts.trim_beta * total) mass += w[byWeight[n++]];
+      keep.assign(byWeight.begin(), byWeight.begin() + n);
+      // at least the heaviest positive and negative, or there is nothing to separate
+      for (bool pos : {true, false}) {
+        if (std::none_of(keep.begin(), keep.end(), [&](auto i){ return (i < Npos) == pos; })) {
+          auto it = std::find_if(byWeight.begin(), byWeight.end(), [&](auto i){ return (i < Npos) == pos; });
+          if (it != byWeight.end()) keep.push_back(*it);
+        }
+      }
+      std::sort(keep.begin(), keep.end());
+    }
+
+    act.clear();
+    aw.clear();
+    auto firstNeg = std::lower_bound(keep.begin(), keep.end(), Npos);
+    for (auto it = keep.begin(); it != firstNeg; ++it) { act.push_back(*it); aw.push_back(w[*it]); }
+    const std::size_t actPos = act.size();
+
+    auto normalize = [&] {
+      double total = std::accumulate(aw.begin(), aw.end(), 0.0);
+      if (total > 0) for (auto& x : aw) x /= total;
+    };
+
+    std::size_t negKept = static_cast<std::size_t>(keep.end() - firstNeg);
+    if (opts.neg_subsample == 0 || opts.neg_subsample >= negKept) {
+      for (auto it = firstNeg; it != keep.end(); ++it) { act.push_back(*it); aw.push_back(w[*it]); }
+      normalize();
+      return actPos;
+    }
+
+    std::vector<double> nw;
+    for (auto it = firstNeg; it != keep.end(); ++it) nw.push_back(w[*it]);
+    const double negMass = std::accumulate(nw.begin(), nw.end(), 0.0);
+    std::discrete_distribution<std::size_t> draw(nw.begin(), nw.end());
+    std::vector<std::size_t> times(nw.size(), 0);
+    for (std::size_t d = 0; d < opts.neg_subsample; ++d) times[draw(rng)]++;
+    for (std::size_t j = 0; j < nw.size(); ++j) {
+      if (!times[j]) continue;
+      act.push_back(firstNeg[j]);
+      aw.push_back(negMass * static_cast<double>(times[j]) / static_cast<double>(opts.neg_subsample));
+    }
+    normalize();
+    return actPos;
+}
+
+// boosting rounds of one stage, shared by trainStage and trainCascade.
+// the search looks at the first maxFeatures of allFeats, onRound(r) is
+// called before every round
+static AdaBoost<int>
+boostStage(const std::vector<Image<long long>>& posIs,
+           const std::vector<Image<long long>>& negIs,
+           const std::vector<HaarFeature<int>>& allFeats,
+           std::size_t maxFeatures,
+           const TrainerOptions& opts,
+           const std::function<void(std::size_t)>& onRound)
+{
+    if (!(opts.trim_beta > 0 && opts.trim_beta <= 1))
+      throw std::invalid_argument("TrainerOptions::trim_beta must be in (0, 1]");
+    if (opts.boosting != Boosting::Discrete && (opts.lut_bins < 2 || opts.lut_bins > kMaxLutBins))
+      throw std::invalid_argument("TrainerOptions::lut_bins must be in 2..256");
+
+    const bool lut = opts.boosting != Boosting::Discrete;
     std::size_t Npos = posIs.size(), Nneg = negIs.size();
     std::size_t N = Npos + Nneg;
     // init weights
@@ -69,87 +220,115 @@ Trainer::trainStage(
     for (std::size_t i = 0; i < N; ++i)
       w[i] = (i < Npos ? w0 : w1);
 
-    // collect all features
-    auto allFeats = makeAllHaarFeatures(opts.window_size);
-
-    AdaBoost<int> strong;
+    AdaBoost<int> stage;
     double sumAlphas = 0;
 
+    auto value = [&](const HaarFeature<int>& feat, std::size_t i) {
+      return i < Npos ? feat(posIs[i], 0, 0) : feat(negIs[i - Npos], 0, 0);
+    };
+
+    std::mt19937 rng(opts.seed);
+    std::vector<std::size_t> act;  // samples searched this round, positives first
+    std::vector<double> aw;        // ...and their weights
+
     // run for R rounds
     for (std::size_t r = 0; r < opts.num_rounds; ++r) {
-      // 1) find best weak: feature + threshold + polarity minimizing weighted error
+      VJ_TRACE_SCOPE("training round");
+      onRound(r);
+
+      // 1) find best weak: stump minimizing weighted error, or table minimizing its score
       double bestErr = std::numeric_limits<double>::infinity();
-      typename AdaBoost<int>::Weak bestW{ allFeats[0], 0, 1, 0 };
-
-      for (auto const& feat : allFeats) {
-        // evaluate feature on all samples
-        std::vector<double> vals(N);
-        for (std::size_t i = 0; i < Npos; ++i) vals[i] = feat(posIs[i], 0, 0);
-        for (std::size_t i = 0; i < Nneg; ++i) vals[Npos + i] = feat(negIs[i], 0, 0);
-
-        // sort to scan thresholds
-        std::vector<std::size_t> idx(N);
-        std::iota(idx.begin(), idx.end(), 0);
-        std::sort(idx.begin(), idx.end(),
-          [&](auto a, auto b){ return vals[a] < vals[b]; });
-
-        // try thresholds between distinct vals
-        double sumPos = 0, sumNeg = 0;
-        for (auto wi : w) {
-          // nothing here – we'll recompute errors below
-        }
+      typename AdaBoost<int>::Weak bestW{ allFeats[0], 0, 1, 0, {} };
+
+      std::cout << "Evaluating " << allFeats.size() << " features...\n";
+
+      // we limit the number of features for faster execution during testing
+      // in their work they have 6000
+      // and computers that were x50 slower...
+      std::size_t featuresToEvaluate = std::min(allFeats.size(), maxFeatures);
+      std::cout << "Using " << featuresToEvaluate << " features for this round\n";
+
+      // samples for the search
+      std::size_t actPos = searchSubset(w, Npos, opts, rng, act, aw);
+      std::cout << "Searching on " << act.size() << "/" << N << " samples ("
+                << actPos << " pos, " << act.size() - actPos << " neg)\n";
+
+      {
+        VJ_TRACE_SCOPE("feature search");
+        std::vector<double> vals(act.size());
+        for (std::size_t featIndex = 0; featIndex < featuresToEvaluate; ++featIndex) {
+          auto const& feat = allFeats[featIndex];
 
-        // lets keep a running error for polarity +1 and -1
-        double wPos=0, wNeg=0;
-        for (auto i : idx) {
-          bool label = (i < Npos);
-          double weight = w[i];
-          // consider threshold at vals[i]
-          // for polarity = +1: predict positive if val < thresh
-          // error = sum weights where pred != label
-          // We can update wPos, wNeg incrementally, but for clarity:
-          double thr = vals[i];
-          for (int polarity : {+1, -1}) {
-            double err = 0;
-            for (std::size_t k = 0; k < N; ++k) {
-              bool pred = (polarity * vals[k] < polarity * thr);
-              if (pred != (k < Npos)) err += w[k];
-            }
-            if (err < bestErr) {
-              bestErr = err;
-              bestW = { feat, static_cast<int>(thr), polarity, 0.0 };
-            }
+          // show progress periodically
+          // I want tqdm for this language
+          if (featIndex % 500 == 0) {
+            std::cout << "Evaluated " << featIndex << "/" << featuresToEvaluate << " features\n";
           }
+          // evaluate feature on the searched samples
+          for (std::size_t i = 0; i < act.size(); ++i) vals[i] = value(feat, act[i]);
+
+          if (lut) searchLut(feat, vals, aw, actPos, opts, bestErr, bestW);
+          else     searchStump(feat, vals, aw, actPos, bestErr, bestW);
         }
       }
 
-      // 2) compute alpha and add weak
-      double err = std::max(bestErr, 1e-10);
-      double alpha = 0.5 * std::log((1 - err) / err);
-      bestW.alpha = alpha;
-      strong.add(std::move(bestW));
-      sumAlphas += alpha;
+      // the chosen feature on every sample, for its error and the weight update
+      std::vector<long long> full(N);
+      for (std::size_t i = 0; i < N; ++i) full[i] = value(bestW.feat, i);
+      auto predicts = [&](std::size_t i) {
+        return bestW.polarity * full[i] < bestW.polarity * bestW.thresh;
+      };
+
+      // 2) compute alpha (tables carry their own confidences) and add weak.
+      //    the search may have seen a trimmed/subsampled set, so the error
+      //    behind alpha is measured again on every sample with the full weights
+      if (!lut) {
+        double err = 0, total = 0;
+        for (std::size_t i = 0; i < N; ++i) {
+          total += w[i];
+          if (predicts(i) != (i < Npos)) err += w[i];
+        }
+        bestErr = std::clamp(err / total, 1e-10, 1 - 1e-10);
+        bestW.alpha = 0.5 * std::log((1 - bestErr) / bestErr);
+        sumAlphas += bestW.alpha;
+      }
 
       // 3) update weights
       for (std::size_t i = 0; i < N; ++i) {
-        auto& weight = w[i];
         bool label = (i < Npos);
-        // re-evaluate weak on sample i
-        auto& wkl = strong.weaks_.back();  // last weak
-        bool pred = (wkl.polarity *
-                     (i < Npos ? wkl.feat(posIs[i],0,0)
-                               : wkl.feat(negIs[i-Npos],0,0))
-                    < wkl.polarity * wkl.thresh);
-        weight *= std::exp(-alpha * (label ? +1 : -1) * (pred ? +1 : -1));
+        if (lut) {
+          w[i] *= std::exp(-(label ? +1 : -1) * bestW.output(full[i]));
+        } else {
+          w[i] *= std::exp(-bestW.alpha * (label ? +1 : -1) * (predicts(i) ? +1 : -1));
+        }
       }
+      stage.add(std::move(bestW));
+
+      std::cout << "Round " << (r+1) << " complete, best " << (lut ? "score" : "error") << ": "
+                << std::fixed << std::setprecision(4) << bestErr << "\n";
+
       // normalize
       double Z = std::accumulate(w.begin(), w.end(), 0.0);
       for (auto& weight : w) weight /= Z;
     }
 
-    // 4) set the strong threshold to half the total alpha
-    strong.setThreshold(0.5 * sumAlphas);
-    return strong;
+    // 4) set the strong threshold to half the total alpha (discrete votes),
+    //    or at zero for the real-valued sum of the tables
+    stage.setThreshold(lut ? 0.0 : 0.5 * sumAlphas);
+    return stage;
+}
+
+
+// train a single AdaBoost stage
+AdaBoost<int>
+Trainer::trainStage(
+    const std::vector<Image<long long>>& posIs,
+    const std::vector<Image<long long>>& negIs,
+    const TrainerOptions& opts)
+{
+    // collect all features
+    auto allFeats = makeAllHaarFeatures(opts.window_size);
+    return boostStage(posIs, negIs, allFeats, allFeats.size(), opts, [](std::size_t){});
 }
 
 // 3) train a cascade by chaining multiple stages, each time removing true negatives.
@@ -165,174 +344,59 @@ Trainer::trainCascade(
     size_t initial_neg_count = negIs.size();
 
     std::cout << "Starting cascade training with " << posIs.size() << " positive and "
-              << negIs.size() << " negative samples" << std::endl;
+              << negIs.size() << " negative samples\n";
+
+    // collect all features
+    auto allFeats = makeAllHaarFeatures(opts.window_size);
 
     // estimate the number of stages needed (for progress tracking)
     int estimatedTotalStages = 10; // arbitrary estimate
     int currentStage = 0;
 
     while (overallFPR > 0.01) {  // stop when cascade is good enough
+      VJ_TRACE_SCOPE("training stage");
       currentStage++;
 
       // train stage with progress tracking for each round
-      AdaBoost<int> stage;
-
-      // prep for training a stage
-      std::size_t Npos = posIs.size(), Nneg = negIs.size();
-      std::size_t N = Npos + Nneg;
-      // init weights
-      std::vector<double> w(N);
-      double w0 = 1.0 / (2*Npos), w1 = 1.0 / (2*Nneg);
-      for (std::size_t i = 0; i < N; ++i)
-        w[i] = (i < Npos ? w0 : w1);
-
-      // collect all features
-      auto allFeats = makeAllHaarFeatures(opts.window_size);
-
-      double sumAlphas = 0;
-
-      // run for R rounds with progress tracking
-      for (std::size_t r = 0; r < opts.num_rounds; ++r) {
+      AdaBoost<int> stage = boostStage(posIs, negIs, allFeats, opts.max_features, opts, [&](std::size_t r) {
         // Report progress - include debug output
-        std::cout << "Training stage " << currentStage << ", round " << (r+1) << "/" << opts.num_rounds << "..." << std::endl;
-        std::cout.flush();
+        std::cout << "Training stage " << currentStage << ", round " << (r+1) << "/" << opts.num_rounds << "...\n";
         if (progressCallback) {
           progressCallback(currentStage, estimatedTotalStages, r+1, opts.num_rounds);
         }
-
-        // 1) find best weak: feature + threshold + polarity minimizing weighted error
-        double bestErr = std::numeric_limits<double>::infinity();
-        typename AdaBoost<int>::Weak bestW{ allFeats[0], 0, 1, 0 };
-
-        std::cout << "Evaluating " << allFeats.size() << " features..." << std::endl;
-        std::cout.flush();
-
-        // we limit the number of features for faster execution during testing
-        // in their work they have 6000
-        // and computers that were x50 slower...
-        std::size_t featuresToEvaluate = std::min(allFeats.size(), static_cast<std::size_t>(5000));
-        std::cout << "Using " << featuresToEvaluate << " features for this round" << std::endl;
-        std::cout.flush();
-
-        for (std::size_t featIndex = 0; featIndex < featuresToEvaluate; ++featIndex) {
-          auto const& feat = allFeats[featIndex];
-
-          // show progress periodically
-          // I want tqdm for this language
-          if (featIndex % 500 == 0) {
-            std::cout << "Evaluated " << featIndex << "/" << featuresToEvaluate << " features" << std::endl;
-            std::cout.flush();
-          }
-          // evaluate feature on all samples
-          std::vector<double> vals(N);
-          for (std::size_t i = 0; i < Npos; ++i) vals[i] = feat(posIs[i], 0, 0);
-          for (std::size_t i = 0; i < Nneg; ++i) vals[Npos + i] = feat(negIs[i], 0, 0);
-
-          // sort to scan thresholds
-          std::vector<std::size_t> idx(N);
-          std::iota(idx.begin(), idx.end(), 0);
-          std::sort(idx.begin(), idx.end(),
-            [&](auto a, auto b){ return vals[a] < vals[b]; });
-
-          // try thresholds between distinct vals
-          double sumPos = 0, sumNeg = 0;
-          for (auto wi : w) {
-            // nothing here – we'll recompute errors below
-          }
-
-          // lets keep a running error for polarity +1 and -1
-          double wPos=0, wNeg=0;
-          for (auto i : idx) {
-            bool label = (i < Npos);
-            double weight = w[i];
-            // consider threshold at vals[i]
-            // for polarity = +1: predict positive if val < thresh
-            // error = sum weights where pred != label
-            // We can update wPos, wNeg incrementally, but for clarity:
-            double thr = vals[i];
-            for (int polarity : {+1, -1}) {
-              double err = 0;
-              for (std::size_t k = 0; k < N; ++k) {
-                bool pred = (polarity * vals[k] < polarity * thr);
-                if (pred != (k < Npos)) err += w[k];
-              }
-              if (err < bestErr) {
-                bestErr = err;
-                bestW = { feat, static_cast<int>(thr), polarity, 0.0 };
-              }
-            }
-          }
-        }
-
-        // 2) compute alpha and add weak
-        double err = std::max(bestErr, 1e-10);
-        double alpha = 0.5 * std::log((1 - err) / err);
-        bestW.alpha = alpha;
-        stage.add(std::move(bestW));
-        sumAlphas += alpha;
-
-        std::cout << "Round " << (r+1) << " complete, best error: " << std::fixed << std::setprecision(4) << bestErr << std::endl;
-        std::cout.flush();
-
-        // 3) update weights
-        for (std::size_t i = 0; i < N; ++i) {
-          auto& weight = w[i];
-          bool label = (i < Npos);
-          // re-evaluate weak on sample i
-          auto& wkl = stage.weaks_.back();  // last weak
-          bool pred = (wkl.polarity *
-                       (i < Npos ? wkl.feat(posIs[i],0,0)
-                                 : wkl.feat(negIs[i-Npos],0,0))
-                      < wkl.polarity * wkl.thresh);
-          weight *= std::exp(-alpha * (label ? +1 : -1) * (pred ? +1 : -1));
-        }
-        // normalize
-        double Z = std::accumulate(w.begin(), w.end(), 0.0);
-        for (auto& weight : w) weight /= Z;
-      }
-
-      // 4) set the strong threshold to half the total alpha
-      stage.setThreshold(0.5 * sumAlphas);
+      });
 
       cascade.addStage(stage);
 
-      // recompute threshold = 0.5 * sum of alphas
-      sumAlphas = 0;
-      for (auto const& w : stage.weaks_)
-        sumAlphas += w.alpha;
-      stage.setThreshold(0.5 * sumAlphas);
-
-      std::cout << "Added stage " << currentStage << " with " << stage.weaks_.size() << " weak classifiers" << std::endl;
-      std::cout.flush();
+      std::cout << "Added stage " << currentStage << " with " << stage.weaks().size() << " weak classifiers\n";
 
       // evaluate on negatives to filter out "easy" ones
-      std::cout << "Evaluating negatives to filter out easy ones..." << std::endl;
-      std::cout.flush();
-
-      std::vector<Image<long long>> hardNegs;
-      int count = 0;
-      for (auto const& I : negIs) {
-        if (cascade.classify(I, 0, 0))
-          hardNegs.push_back(I);
-
-        // show progress periodically when evaluating negatives
-        if (++count % 10 == 0) {
-          std::cout << "Evaluated " << count << "/" << negIs.size() << " negatives" << std::endl;
-          std::cout.flush();
+      std::cout << "Evaluating negatives to filter out easy ones...\n";
+
+      {
+        VJ_TRACE_SCOPE("negative filtering");
+        std::vector<Image<long long>> hardNegs;
+        int count = 0;
+        for (auto const& I : negIs) {
+          if (cascade.classify(I, 0, 0))
+            hardNegs.push_back(I);
+
+          // show progress periodically when evaluating negatives
+          if (++count % 10 == 0) {
+            std::cout << "Evaluated " << count << "/" << negIs.size() << " negatives\n";
+          }
         }
+        negIs.swap(hardNegs);
       }
-      negIs.swap(hardNegs);
 
       // update overall FPR/TPR if desired...
       overallFPR = double(negIs.size()) / std::max<size_t>(1, initial_neg_count);
       std::cout << "Stage " << currentStage << " complete. Hard negatives: " << negIs.size()
-                << ", Overall FPR: " << std::fixed << std::setprecision(4) << overallFPR << std::endl;
-      std::cout.flush();
+                << ", Overall FPR: " << std::fixed << std::setprecision(4) << overallFPR << "\n";
 
       // break if no more negatives
       if (negIs.empty()) {
-        std::cout << "No more negative samples, stopping cascade training" << std::endl;
-        std::cout.flush();
+        std::cout << "No more negative samples, stopping cascade training\n";
         break;
       }
     }
@@ -0,0 +1,71 @@
+// validates the fixed-point CompiledCascade against the reference
+// double-precision CascadeClassifier: runs the detector sweep over a set of
+// images and compares every stage decision on every window. exits with 2
+// if any stage or window decision differs
+
+#include <iostream>
+#include <fstream>
+#include <cstdint>
+#include <algorithm>
+#include <opencv2/opencv.hpp>
+#include "viola_jones/Detector.h"
+#include "viola_jones/utils.hpp"
+
+int main(int argc, char** argv)
+{
+    if (argc != 3) {
+        std::cerr << "Usage: " << argv[0] << " <cascade_file> <image_glob>\n";
+        return 1;
+    }
+
+    std::ifstream in(argv[1]);
+    if (!in) {
+        std::cerr << "erorik: could not open cascade file " << argv[1] << "\n";
+        return 1;
+    }
+    const vj::Detector<int> detector(vj::CascadeClassifier<int>::load(in));
+    auto const& stages   = detector.cascade().stages();
+    auto const& compiled = detector.compiled().stages();
+
+    std::vector<cv::String> files;
+    cv::glob(argv[2], files);
+
+    std::uint64_t windows = 0, stage_checks = 0, stage_mismatches = 0, window_mismatches = 0;
+    std::uint64_t ref_features = 0;
+    vj::CompiledCascade<int>::EvalStats stats;
+    for (auto const& file : files) {
+        cv::Mat gray = cv::imread(file, cv::IMREAD_GRAYSCALE);
+        if (gray.empty()) {
+            std::cerr << "Warning: Could not load file " << file << std::endl;
+            continue;
+        }
+        auto frame = lumaView(gray);
+        detector.scan(frame, { 0, 0, gray.cols, gray.rows },
+                      [&](const auto&, const vj::Image<long long>& I, int x, int y) {
+            windows++;
+            for (std::size_t s = 0; s < stages.size(); ++s) {
+                std::size_t n = 0;
+                bool ref = stages[s].classify(I, x, y, n);
+                bool fix = vj::CompiledCascade<int>::classifyStage(compiled[s], I, x, y);
+                ref_features += n;
+                stage_checks++;
+                if (ref != fix) stage_mismatches++;
+                if (!ref || !fix) break;
+            }
+            if (detector.cascade().classify(I, x, y) != detector.compiled().classify(I, x, y, stats))
+                window_mismatches++;
+        });
+    }
+
+    std::cout << "images: " << files.size() << "\n"
+              << "windows: " << windows << "\n"
+              << "stage decisions compared: " << stage_checks << "\n"
+              << "stage mismatches: " << stage_mismatches << "\n"
+              << "window mismatches: " << window_mismatches << "\n"
+              << "fixed-point error bound (alpha units): " << detector.compiled().errorBound() << "\n"
+              << "features per stage (early exit): "
+              << static_cast<double>(ref_features) / std::max<std::uint64_t>(1, stage_checks) << " reference, "
+              << stats.perStage() << " fixed point\n"
+              << "features per window (fixed point): " << stats.perWindow() << "\n";
+    return window_mismatches == 0 && stage_mismatches == 0 ? 0 : 2;
+}
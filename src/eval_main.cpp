@@ -0,0 +1,251 @@
+// detection quality + throughput on an annotated image set
+//
+// annotation file (FDDB layout), per image:
+//   <image path, relative to image_dir>
+//   <number of faces>
+//   one line per face, either a rect      "x y w h"
+//                      or an FDDB ellipse "major_radius minor_radius angle cx cy 1"
+//
+// the detector runs once per stage-threshold offset (ROC sweep). a detection
+// counts as a hit when its IoU with a still unmatched annotation is >= --iou.
+// results go to stdout and, as JSON, to --out
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <chrono>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <opencv2/opencv.hpp>
+#include "viola_jones/Detector.h"
+#include "viola_jones/utils.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Annotated {
+    std::string                path;
+    std::vector<vj::Rect<int>> faces;
+};
+
+bool readAnnotations(const std::string& file, std::vector<Annotated>& out)
+{
+    std::ifstream in(file);
+    if (!in) return false;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty()) continue;
+        Annotated a;
+        a.path = line;
+        if (!std::getline(in, line)) return false;
+        int n = std::stoi(line);
+        for (int i = 0; i < n && std::getline(in, line); ++i) {
+            std::istringstream ls(line);
+            std::vector<double> v;
+            for (double d; ls >> d;) v.push_back(d);
+            if (v.size() == 4) {
+                a.faces.push_back({ static_cast<int>(v[0]), static_cast<int>(v[1]),
+                                    static_cast<int>(v[2]), static_cast<int>(v[3]) });
+            } else if (v.size() >= 5) {
+                // bounding box of the rotated ellipse
+                double ra = v[0], rb = v[1], t = v[2], cx = v[3], cy = v[4];
+                double hx = std::hypot(ra * std::cos(t), rb * std::sin(t));
+                double hy = std::hypot(ra * std::sin(t), rb * std::cos(t));
+                a.faces.push_back({ static_cast<int>(std::lround(cx - hx)), static_cast<int>(std::lround(cy - hy)),
+                                    static_cast<int>(std::lround(2 * hx)), static_cast<int>(std::lround(2 * hy)) });
+            } else {
+                return false;
+            }
+        }
+        out.push_back(std::move(a));
+    }
+    return true;
+}
+
+double iou(const vj::Rect<int>& a, const vj::Rect<int>& b)
+{
+    int x0 = std::max(a.x, b.x), y0 = std::max(a.y, b.y);
+    int x1 = std::min(a.x + a.w, b.x + b.w), y1 = std::min(a.y + a.h, b.y + b.h);
+    double inter = std::max(0, x1 - x0) * static_cast<double>(std::max(0, y1 - y0));
+    double uni = static_cast<double>(a.w) * a.h + static_cast<double>(b.w) * b.h - inter;
+    return uni > 0 ? inter / uni : 0;
+}
+
+// one point of the ROC sweep
+struct Point {
+    double        offset = 0;
+    std::uint64_t tp = 0, fp = 0, fn = 0;
+    double        seconds = 0;
+    vj::CompiledCascade<int>::EvalStats work;  // windows and learners evaluated
+};
+
+std::vector<double> parseList(const std::string& s)
+{
+    std::vector<double> v;
+    std::stringstream ss(s);
+    for (std::string item; std::getline(ss, item, ',');) v.push_back(std::stod(item));
+    return v;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    if (argc < 4) {
+        std::cerr << "Usage: " << argv[0] << " <cascade_file> <image_dir> <annotations>\n"
+                  << "  [--out results.json] [--ext .jpg] [--offsets -4,-2,0,2,4] [--iou 0.5]\n"
+                  << "  [--scale-factor 1.3] [--step-ratio 4] [--min-neighbors 2] [--max-scales 10]\n"
+                  << "  [--min-face-ratio 0.05] [--max-face-ratio 0.8] [--tile-kb 256] [--tile-threads N]\n"
+                  << "  [--group-weights 0|1]\n";
+        return 1;
+    }
+
+    vj::ScanParams params;
+    params.tile_threads = 0;  // the only caller, tiles may use every core
+    std::string out_path, ext;
+    std::vector<double> offsets{ 0 };
+    double min_iou = 0.5;
+    for (int i = 4; i < argc; i += 2) {
+        if (i + 1 >= argc) {
+            std::cerr << "missing value for option " << argv[i] << "\n";
+            return 1;
+        }
+        std::string k = argv[i], v = argv[i + 1];
+        if (k == "--out") out_path = v;
+        else if (k == "--ext") ext = v;
+        else if (k == "--offsets") offsets = parseList(v);
+        else if (k == "--iou") min_iou = std::stod(v);
+        else if (k == "--scale-factor") params.scale_factor = std::stod(v);
+        else if (k == "--step-ratio") params.step_ratio = std::stoi(v);
+        else if (k == "--min-neighbors") params.min_neighbors = std::stoi(v);
+        else if (k == "--max-scales") params.max_scales = std::stoi(v);
+        else if (k == "--min-face-ratio") params.min_face_ratio = std::stod(v);
+        else if (k == "--max-face-ratio") params.max_face_ratio = std::stod(v);
+        else if (k == "--tile-kb") { params.tiled = true; params.tile_cache_bytes = std::stoul(v) * 1024; }
+        else if (k == "--group-weights") params.group_weights = std::stoi(v) != 0;
+        else if (k == "--tile-threads") params.tile_threads = static_cast<unsigned>(std::stoul(v));
+        else {
+            std::cerr << "unknown option " << k << "\n";
+            return 1;
+        }
+    }
+
+    std::ifstream in(argv[1]);
+    if (!in) {
+        std::cerr << "erorik: could not open cascade file " << argv[1] << "\n";
+        return 1;
+    }
+    const auto cascade = vj::CascadeClassifier<int>::load(in);
+
+    std::vector<Annotated> dataset;
+    if (!readAnnotations(argv[3], dataset)) {
+        std::cerr << "could not parse annotations " << argv[3] << "\n";
+        return 1;
+    }
+
+    // one detector per threshold offset
+    std::vector<vj::Detector<int>> detectors;
+    std::vector<Point> points;
+    for (double off : offsets) {
+        auto c = cascade;
+        c.offsetStageThresholds(off);
+        detectors.emplace_back(std::move(c), params);
+        Point pt;
+        pt.offset = off;
+        points.push_back(pt);
+    }
+
+    std::size_t images = 0, annotations = 0;
+    for (auto const& item : dataset) {
+        std::string file = std::string(argv[2]) + "/" + item.path + ext;
+        cv::Mat gray = cv::imread(file, cv::IMREAD_GRAYSCALE);
+        if (gray.empty()) {
+            std::cerr << "Warning: Could not load file " << file << std::endl;
+            continue;
+        }
+        images++;
+        annotations += item.faces.size();
+        auto frame = lumaView(gray);
+
+        for (std::size_t o = 0; o < detectors.size(); ++o) {
+            auto& pt = points[o];
+
+            auto t0 = Clock::now();
+            auto found = detectors[o].detect(frame);
+            pt.seconds += std::chrono::duration<double>(Clock::now() - t0).count();
+
+            // windows visited and learners run, counted in a separate (untimed) sweep
+            detectors[o].scan(frame, { 0, 0, gray.cols, gray.rows },
+                              [&](const auto&, const vj::Image<long long>& I, int x, int y) {
+                detectors[o].compiled().classify(I, x, y, pt.work);
+            });
+
+            // greedy matching, strongest groups first
+            std::sort(found.begin(), found.end(),
+                      [](auto const& a, auto const& b) { return a.weight > b.weight; });
+            std::vector<bool> used(item.faces.size(), false);
+            for (auto const& d : found) {
+                double best = min_iou;
+                std::size_t hit = item.faces.size();
+                for (std::size_t f = 0; f < item.faces.size(); ++f) {
+                    double v = used[f] ? 0 : iou(d.box, item.faces[f]);
+                    if (v >= best) { best = v; hit = f; }
+                }
+                if (hit < item.faces.size()) { used[hit] = true; pt.tp++; }
+                else pt.fp++;
+            }
+            pt.fn += static_cast<std::uint64_t>(std::count(used.begin(), used.end(), false));
+        }
+    }
+
+    auto precision = [](const Point& p) { return p.tp + p.fp ? double(p.tp) / double(p.tp + p.fp) : 1.0; };
+    auto recall    = [](const Point& p) { return p.tp + p.fn ? double(p.tp) / double(p.tp + p.fn) : 0.0; };
+    const double n = std::max<std::size_t>(1, images);
+
+    std::cout << "images: " << images << ", annotated faces: " << annotations << "\n"
+              << std::setw(8) << "offset" << std::setw(11) << "precision" << std::setw(9) << "recall"
+              << std::setw(9) << "fp/img" << std::setw(14) << "windows/img" << std::setw(14) << "feats/stage" << std::setw(10) << "img/s" << "\n";
+    for (auto const& p : points) {
+        std::cout << std::fixed << std::setprecision(3)
+                  << std::setw(8) << p.offset << std::setw(11) << precision(p) << std::setw(9) << recall(p)
+                  << std::setw(9) << p.fp / n << std::setw(14) << std::setprecision(0) << p.work.windows / n
+                  << std::setw(14) << std::setprecision(2) << p.work.perStage()
+                  << std::setw(10) << std::setprecision(2) << (p.seconds > 0 ? images / p.seconds : 0) << "\n";
+    }
+
+    if (!out_path.empty()) {
+        std::ofstream js(out_path);
+        js << std::setprecision(6)
+           << "{\n  \"cascade\": \"" << argv[1] << "\",\n"
+           << "  \"images\": " << images << ",\n  \"annotations\": " << annotations << ",\n"
+           << "  \"iou\": " << min_iou << ",\n"
+           << "  \"scan\": {\"base_window_size\": " << params.base_window_size
+           << ", \"scale_factor\": " << params.scale_factor
+           << ", \"step_ratio\": " << params.step_ratio
+           << ", \"min_neighbors\": " << params.min_neighbors
+           << ", \"max_scales\": " << params.max_scales
+           << ", \"min_face_ratio\": " << params.min_face_ratio
+           << ", \"max_face_ratio\": " << params.max_face_ratio
+           << ", \"group_weights\": " << (params.group_weights ? "true" : "false")
+           << ", \"tiled\": " << (params.tiled ? "true" : "false")
+           << ", \"tile_cache_bytes\": " << params.tile_cache_bytes << "},\n"
+           << "  \"roc\": [\n";
+        for (std::size_t i = 0; i < points.size(); ++i) {
+            auto const& p = points[i];
+            js << "    {\"offset\": " << p.offset << ", \"tp\": " << p.tp << ", \"fp\": " << p.fp
+               << ", \"fn\": " << p.fn << ", \"precision\": " << precision(p) << ", \"recall\": " << recall(p)
+               << ", \"fp_per_image\": " << p.fp / n << ", \"windows_per_image\": " << p.work.windows / n
+               << ", \"features_per_window\": " << p.work.perWindow()
+               << ", \"features_per_stage\": " << p.work.perStage()
+               << ", \"images_per_second\": " << (p.seconds > 0 ? images / p.seconds : 0) << "}"
+               << (i + 1 < points.size() ? ",\n" : "\n");
+        }
+        js << "  ]\n}\n";
+        std::cout << "results written to " << out_path << "\n";
+    }
+    return 0;
+}
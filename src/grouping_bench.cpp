@@ -0,0 +1,121 @@
+// benchmark: vj::groupDetections vs cv::groupRectangles on synthetic frames
+// with dense hits (many overlapping windows around every "face" + scattered
+// false positives), the situation we get with small steps or permissive cascades
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <tuple>
+#include <opencv2/opencv.hpp>
+#include "viola_jones/Grouping.h"
+
+namespace {
+
+// hits the scanner would produce around random objects in a W×H frame
+std::vector<cv::Rect> makeDenseHits(std::size_t target_hits, int W, int H, std::mt19937& rng)
+{
+    const int base_window_size = 24;
+    const double scale_factor = 1.3;
+    std::vector<cv::Rect> hits;
+    std::uniform_int_distribution<int> level(0, 6);
+    std::uniform_int_distribution<int> jitter(-3, 3);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+
+    while (hits.size() < target_hits) {
+        // one "face": a burst of neighbouring windows over 2-3 adjacent scales
+        int lv = level(rng);
+        int size = cvRound(base_window_size * std::pow(scale_factor, lv));
+        int cx = static_cast<int>(unit(rng) * std::max(1, W - size));
+        int cy = static_cast<int>(unit(rng) * std::max(1, H - size));
+        for (int l = lv; l <= lv + 1; ++l) {
+            int s = cvRound(base_window_size * std::pow(scale_factor, l));
+            for (int k = 0; k < 12; ++k)
+                hits.emplace_back(cx + jitter(rng), cy + jitter(rng), s, s);
+        }
+        // and a couple of isolated false positives
+        for (int k = 0; k < 4; ++k) {
+            int s = cvRound(base_window_size * std::pow(scale_factor, level(rng)));
+            hits.emplace_back(static_cast<int>(unit(rng) * (W - s)),
+                              static_cast<int>(unit(rng) * (H - s)), s, s);
+        }
+    }
+    hits.resize(target_hits);
+    return hits;
+}
+
+bool sameRects(std::vector<cv::Rect> a, std::vector<cv::Rect> b)
+{
+    auto key = [](const cv::Rect& r){ return std::tie(r.x, r.y, r.width, r.height); };
+    auto less = [&](const cv::Rect& l, const cv::Rect& r){ return key(l) < key(r); };
+    std::sort(a.begin(), a.end(), less);
+    std::sort(b.begin(), b.end(), less);
+    if (a.size() != b.size()) return false;
+    for (std::size_t i = 0; i < a.size(); ++i) {
+        // both average in double, only rounding of .5 cases may differ
+        if (std::abs(a[i].x - b[i].x) > 1 || std::abs(a[i].y - b[i].y) > 1 ||
+            std::abs(a[i].width - b[i].width) > 1 || std::abs(a[i].height - b[i].height) > 1)
+            return false;
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    const int W = 1920, H = 1080;
+    const int min_neighbors = 2;
+    const double eps = 0.2;
+    const int repeats = argc > 1 ? std::max(1, std::atoi(argv[1])) : 5;
+
+    std::mt19937 rng(42);
+    using clock = std::chrono::steady_clock;
+
+    std::cout << std::setw(8) << "hits"
+              << std::setw(14) << "opencv ms"
+              << std::setw(14) << "vj ms"
+              << std::setw(10) << "speedup"
+              << std::setw(8) << "groups"
+              << "  match\n";
+
+    for (std::size_t n : {500, 2000, 8000, 32000}) {
+        auto hits = makeDenseHits(n, W, H, rng);
+
+        std::vector<vj::Detection> dets;
+        dets.reserve(hits.size());
+        for (auto const& r : hits)
+            dets.push_back({ {r.x, r.y, r.width, r.height} });
+
+        double cv_ms = 0, vj_ms = 0;
+        std::vector<cv::Rect> cv_out, vj_out;
+        for (int rep = 0; rep < repeats; ++rep) {
+            auto a = hits;
+            auto t0 = clock::now();
+            cv::groupRectangles(a, min_neighbors, eps);
+            auto t1 = clock::now();
+            auto g = vj::groupDetections(dets, {min_neighbors, eps});
+            auto t2 = clock::now();
+
+            cv_ms += std::chrono::duration<double, std::milli>(t1 - t0).count();
+            vj_ms += std::chrono::duration<double, std::milli>(t2 - t1).count();
+            cv_out = a;
+            vj_out.clear();
+            for (auto const& d : g)
+                vj_out.emplace_back(d.box.x, d.box.y, d.box.w, d.box.h);
+        }
+        cv_ms /= repeats;
+        vj_ms /= repeats;
+
+        std::cout << std::setw(8) << n
+                  << std::setw(14) << std::fixed << std::setprecision(3) << cv_ms
+                  << std::setw(14) << vj_ms
+                  << std::setw(9) << std::setprecision(1) << cv_ms / std::max(vj_ms, 1e-6) << "x"
+                  << std::setw(8) << vj_out.size()
+                  << "  " << (sameRects(cv_out, vj_out) ? "yes" : "NO") << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,109 @@
+// offline cascade optimizer: reorders weak learners using statistics from
+// validation frames, then checks that the optimized cascade makes exactly
+// the same decisions
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <limits>
+#include <string>
+#include <cstdint>
+#include <opencv2/opencv.hpp>
+#include "viola_jones/Detector.h"
+#include "viola_jones/CascadeOptimizer.h"
+#include "viola_jones/utils.hpp"
+
+int main(int argc, char** argv)
+{
+    if (argc < 4) {
+        std::cerr << "Usage: " << argv[0]
+                  << " <cascade_in> <image_glob> <cascade_out> [--max-windows N]\n";
+        return 1;
+    }
+
+    std::size_t max_windows = 2000000;
+    for (int i = 4; i < argc; ++i) {
+        std::string a = argv[i];
+        if (a == "--max-windows" && i + 1 < argc) max_windows = std::stoull(argv[++i]);
+        else {
+            std::cerr << "unknown option " << a << "\n";
+            return 1;
+        }
+    }
+
+    std::ifstream in(argv[1]);
+    if (!in) {
+        std::cerr << "erorik: could not open cascade file " << argv[1] << "\n";
+        return 1;
+    }
+    const vj::Detector<int> before(vj::CascadeClassifier<int>::load(in));
+
+    std::vector<cv::String> files;
+    cv::glob(argv[2], files);
+    std::vector<cv::Mat> frames;
+    for (auto const& file : files) {
+        cv::Mat gray = cv::imread(file, cv::IMREAD_GRAYSCALE);
+        if (gray.empty()) {
+            std::cerr << "Warning: Could not load file " << file << std::endl;
+            continue;
+        }
+        frames.push_back(gray);
+    }
+    if (frames.empty()) {
+        std::cerr << "Oops no validation frames loaded\n";
+        return 1;
+    }
+
+    // 1) statistics: which learners vote on the windows the detector visits
+    vj::CascadeOptimizer<int> optimizer(before.cascade());
+    for (auto const& gray : frames) {
+        before.scan(lumaView(gray), { 0, 0, gray.cols, gray.rows },
+                    [&](const auto&, const vj::Image<long long>& I, int x, int y) {
+            if (optimizer.windows() < max_windows)
+                optimizer.addWindow(I, x, y);
+        });
+    }
+
+    vj::OptimizerReport report;
+    auto optimized = optimizer.optimize(report);
+
+    // 2) round-trip through the text format, exactly as it will be loaded later
+    std::stringstream text;
+    text << std::setprecision(std::numeric_limits<double>::max_digits10);
+    optimized.save(text);
+    const vj::Detector<int> after(vj::CascadeClassifier<int>::load(text), before.params());
+
+    // 3) same decisions on every window, and what it actually costs
+    std::uint64_t windows = 0, mismatches = 0;
+    vj::CompiledCascade<int>::EvalStats stats_before, stats_after;
+    for (auto const& gray : frames) {
+        before.scan(lumaView(gray), { 0, 0, gray.cols, gray.rows },
+                    [&](const auto&, const vj::Image<long long>& I, int x, int y) {
+            windows++;
+            if (before.compiled().classify(I, x, y, stats_before) != after.compiled().classify(I, x, y, stats_after))
+                mismatches++;
+        });
+    }
+
+    std::ostringstream rep;
+    report.print(rep);
+    rep << "measured features per window:         "
+        << stats_before.perWindow() << " -> " << stats_after.perWindow() << "\n"
+        << "measured features per stage:          "
+        << stats_before.perStage() << " -> " << stats_after.perStage() << "\n"
+        << "decision mismatches: " << mismatches << " / " << windows << " windows\n";
+    std::cout << rep.str();
+
+    if (mismatches != 0) {
+        std::cerr << "optimized cascade changes decisions, not writing it\n";
+        return 2;
+    }
+
+    std::ofstream out(argv[3]);
+    out << std::setprecision(std::numeric_limits<double>::max_digits10);
+    optimized.save(out);
+    std::ofstream(std::string(argv[3]) + ".report.txt") << rep.str();
+    std::cout << "optimized cascade written to " << argv[3] << "\n";
+    return 0;
+}
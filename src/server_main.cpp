@@ -0,0 +1,298 @@
+// long-lived detection daemon: loads the cascade once and serves grayscale
+// frames over a unix domain socket, so callers that only need a few face
+// boxes don't pay cascade parsing + thread startup on every use
+//
+// protocol (all fields uint32 in host byte order, a connection can send any
+// number of requests, replies come back in request order):
+//   request : magic 'VJQ1', width, height, stride, then stride*height bytes
+//             of 8-bit luma (rows `stride` bytes apart)
+//   response: magic 'VJR1', status (0 = ok, 1 = bad request, 2 = busy),
+//             count, queue_depth, latency_us, then count * (x, y, w, h) as int32
+// a request is bad when its header is malformed or stride*height is over
+// 64 MiB (an 8K frame); the connection is closed after that reply. busy is
+// sent (and the connection closed) when kMaxConnections clients are open
+// queue_depth is the number of requests still waiting when this one was
+// picked up, latency_us is the time from the request being fully read to the
+// response being ready
+//
+// a connection has at most one request in the pool: the next one is read only
+// after the previous reply went out, so two workers never answer the same
+// connection out of order (pipelined requests wait in the socket buffer)
+
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "viola_jones/Detector.h"
+#include "viola_jones/WorkQueue.h"
+#include "viola_jones/Trace.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr std::uint32_t kRequestMagic  = 0x31514A56; // "VJQ1"
+constexpr std::uint32_t kResponseMagic = 0x31524A56; // "VJR1"
+constexpr std::uint32_t kMaxSide = 16384;
+constexpr std::uint64_t kMaxRequestBytes = 64ull << 20;  // luma bytes per request
+constexpr std::size_t   kMaxConnections  = 64;
+
+enum Status : std::uint32_t { kOk = 0, kBadRequest = 1, kBusy = 2 };
+
+struct Connection {
+    int                     fd = -1;
+    std::mutex              mutex;
+    std::condition_variable answered;
+    bool                    in_flight = false;  // a request of ours is in the pool
+    std::atomic<bool>       finished{false};    // reader thread is done, can be joined
+    ~Connection() { if (fd >= 0) ::close(fd); }
+
+    void sent() {
+        std::lock_guard<std::mutex> lock(mutex);
+        in_flight = true;
+    }
+    void replied() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            in_flight = false;
+        }
+        answered.notify_one();
+    }
+    void waitReply() {
+        std::unique_lock<std::mutex> lock(mutex);
+        answered.wait(lock, [&]{ return !in_flight; });
+    }
+};
+
+struct Request {
+    std::shared_ptr<Connection> conn;
+    std::uint32_t               width = 0, height = 0, stride = 0;
+    std::vector<std::uint8_t>   pixels;
+    Clock::time_point           received;
+};
+
+bool readAll(int fd, void* buf, std::size_t n) {
+    auto* p = static_cast<char*>(buf);
+    while (n > 0) {
+        ssize_t r = ::read(fd, p, n);
+        if (r <= 0) return false;
+        p += r; n -= static_cast<std::size_t>(r);
+    }
+    return true;
+}
+
+bool writeAll(int fd, const void* buf, std::size_t n) {
+    auto* p = static_cast<const char*>(buf);
+    while (n > 0) {
+        ssize_t r = ::send(fd, p, n, MSG_NOSIGNAL);
+        if (r <= 0) return false;
+        p += r; n -= static_cast<std::size_t>(r);
+    }
+    return true;
+}
+
+void sendResponse(Connection& conn, std::uint32_t status, const std::vector<vj::Detection>& boxes,
+                  std::uint32_t queue_depth, std::uint32_t latency_us)
+{
+    std::vector<std::uint32_t> msg{ kResponseMagic, status,
+                                    static_cast<std::uint32_t>(boxes.size()),
+                                    queue_depth, latency_us };
+    for (auto const& d : boxes) {
+        for (int v : {d.box.x, d.box.y, d.box.w, d.box.h}) {
+            std::int32_t s = v;
+            std::uint32_t u;
+            std::memcpy(&u, &s, sizeof(u));
+            msg.push_back(u);
+        }
+    }
+    // only one request per connection is in flight, so no write lock needed
+    writeAll(conn.fd, msg.data(), msg.size() * sizeof(std::uint32_t));
+}
+
+// aggregate numbers, printed every `report_every` requests
+struct Stats {
+    std::mutex    mutex;
+    std::uint64_t served = 0;
+    double        latency_sum_us = 0, latency_max_us = 0;
+    std::size_t   max_queue_depth = 0;
+
+    void record(double latency_us, std::size_t depth, std::uint64_t report_every) {
+        std::lock_guard<std::mutex> lock(mutex);
+        served++;
+        latency_sum_us += latency_us;
+        latency_max_us = std::max(latency_max_us, latency_us);
+        max_queue_depth = std::max(max_queue_depth, depth);
+        if (served % report_every == 0) {
+            std::cout << "served " << served
+                      << " | latency mean " << latency_sum_us / report_every / 1000.0
+                      << " ms max " << latency_max_us / 1000.0
+                      << " ms | max queue depth " << max_queue_depth << "\n";
+            latency_sum_us = latency_max_us = 0;
+            max_queue_depth = 0;
+        }
+    }
+};
+
+// one thread per client connection, reads a request, enqueues it and waits
+// for its reply before reading the next
+void serveConnection(std::shared_ptr<Connection> conn, vj::WorkQueue<Request>& queue)
+{
+    for (;;) {
+        std::uint32_t header[4];
+        if (!readAll(conn->fd, header, sizeof(header))) return;
+
+        Request req;
+        req.conn   = conn;
+        req.width  = header[1];
+        req.height = header[2];
+        req.stride = header[3];
+        if (header[0] != kRequestMagic || req.width == 0 || req.height == 0 ||
+            req.width > kMaxSide || req.height > kMaxSide ||
+            req.stride < req.width || req.stride > 4 * kMaxSide ||
+            static_cast<std::uint64_t>(req.stride) * req.height > kMaxRequestBytes) {
+            std::cerr << "warning: malformed request, closing connection\n";
+            sendResponse(*conn, kBadRequest, {}, 0, 0);
+            return;
+        }
+
+        req.pixels.resize(static_cast<std::size_t>(req.stride) * req.height);
+        if (!readAll(conn->fd, req.pixels.data(), req.pixels.size())) return;
+        req.received = Clock::now();
+        conn->sent();
+        queue.push(std::move(req));
+        conn->waitReply();
+    }
+}
+
+std::atomic<bool> g_stop{false};
+int g_listen_fd = -1;
+
+void onSignal(int) {
+    g_stop = true;
+    // unblocks accept()
+    if (g_listen_fd >= 0) ::shutdown(g_listen_fd, SHUT_RDWR);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0]
+                  << " <cascade_file> <socket_path> [workers]\n";
+        return 1;
+    }
+    const std::string socket_path = argv[2];
+    const unsigned workers = argc > 3 ? static_cast<unsigned>(std::max(1, std::stoi(argv[3])))
+                                      : std::max(1u, std::thread::hardware_concurrency());
+
+    std::ifstream in(argv[1]);
+    if (!in) {
+        std::cerr << "erorik: could not open cascade file " << argv[1] << "\n";
+        return 1;
+    }
+    // loaded once, shared read-only by every worker
+    const vj::Detector<int> detector(vj::CascadeClassifier<int>::load(in));
+    std::cout << "loading cascade classifier from " << argv[1] << "\n";
+    vj::trace::startFromEnv();
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (fd < 0 || socket_path.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "could not create socket " << socket_path << "\n";
+        return 1;
+    }
+    std::strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+    ::unlink(socket_path.c_str());
+    if (::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || ::listen(fd, 64) < 0) {
+        std::cerr << "could not listen on " << socket_path << ": " << std::strerror(errno) << "\n";
+        ::close(fd);
+        return 1;
+    }
+    g_listen_fd = fd;
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+
+    vj::WorkQueue<Request> queue;
+    Stats stats;
+    const std::uint64_t report_every = 100;
+
+    std::vector<std::thread> pool;
+    for (unsigned i = 0; i < workers; ++i) {
+        pool.emplace_back([&] {
+            while (auto req = queue.pop()) {
+                VJ_TRACE_SCOPE("request");
+                std::size_t depth = queue.size();
+                // straight from the received bytes, no copy
+                auto boxes = detector.detect(vj::LumaView::planar(
+                    req->pixels.data(), req->width, req->height, req->stride));
+                double latency_us = std::chrono::duration<double, std::micro>(
+                    Clock::now() - req->received).count();
+                sendResponse(*req->conn, kOk, boxes, static_cast<std::uint32_t>(depth),
+                             static_cast<std::uint32_t>(latency_us));
+                req->conn->replied();
+                stats.record(latency_us, depth, report_every);
+            }
+        });
+    }
+    std::cout << "listening on " << socket_path << " with " << workers << " workers\n";
+
+    // reader threads, joined before the queue they push to goes away
+    struct Client {
+        std::shared_ptr<Connection> conn;
+        std::thread                 reader;
+    };
+    std::vector<Client> clients;
+
+    while (!g_stop) {
+        int client = ::accept(fd, nullptr, nullptr);
+        if (client < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        // reap connections that hung up
+        for (auto it = clients.begin(); it != clients.end();) {
+            if (it->conn->finished) { it->reader.join(); it = clients.erase(it); }
+            else ++it;
+        }
+        auto conn = std::make_shared<Connection>();
+        conn->fd = client;
+        if (clients.size() >= kMaxConnections) {
+            std::cerr << "warning: " << kMaxConnections << " connections open, refusing a new one\n";
+            sendResponse(*conn, kBusy, {}, 0, 0);
+            continue;  // conn closes the socket
+        }
+        clients.push_back({ conn, std::thread([conn, &queue] {
+            serveConnection(conn, queue);
+            conn->finished = true;
+        }) });
+    }
+
+    // unblock the readers; one waiting for its reply gets it from the
+    // still running workers
+    for (auto& c : clients) ::shutdown(c.conn->fd, SHUT_RDWR);
+    for (auto& c : clients) c.reader.join();
+    clients.clear();
+
+    queue.close();
+    for (auto& t : pool) t.join();
+    vj::trace::finish();
+    ::close(fd);
+    ::unlink(socket_path.c_str());
+    return 0;
+}
@@ -0,0 +1,226 @@
+// many video sources on one worker pool: each source runs at its own frame
+// rate, frames are shared out by the StreamScheduler (round-robin over the
+// streams, newest frame per stream, stale frames dropped at the deadline)
+// and the run ends with per-stream fps, drops and latency
+//
+// a source is a video file (replayed in a loop at its own fps, like a camera)
+// or "synthetic:WxH@FPS", a generated moving pattern for load tests
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include <cstdio>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "viola_jones/Detector.h"
+#include "viola_jones/StreamScheduler.h"
+#include "viola_jones/Trace.h"
+#include "viola_jones/utils.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// one frame source, always hands out 8-bit gray frames
+class Source {
+public:
+    virtual ~Source() = default;
+    virtual bool read(cv::Mat& gray) = 0;
+    virtual double fps() const = 0;
+};
+
+class VideoSource : public Source {
+public:
+    explicit VideoSource(const std::string& path) : cap_(path) {}
+    bool opened() const { return cap_.isOpened(); }
+
+    bool read(cv::Mat& gray) override {
+        cv::Mat frame;
+        if (!cap_.read(frame)) {
+            // replay from the start
+            cap_.set(cv::CAP_PROP_POS_FRAMES, 0);
+            if (!cap_.read(frame)) return false;
+        }
+        cv::cvtColor(frame, gray, cv::COLOR_BGR2GRAY);
+        return true;
+    }
+
+    double fps() const override {
+        double f = cap_.get(cv::CAP_PROP_FPS);
+        return f > 0 ? f : 25.0;
+    }
+
+private:
+    mutable cv::VideoCapture cap_;
+};
+
+// gradient background with a bright disc moving across it
+class SyntheticSource : public Source {
+public:
+    SyntheticSource(int w, int h, double fps) : fps_(fps), base_(h, w, CV_8UC1) {
+        for (int y = 0; y < h; ++y)
+            for (int x = 0; x < w; ++x)
+                base_.at<std::uint8_t>(y, x) = static_cast<std::uint8_t>((x + 2 * y) % 256);
+    }
+
+    bool read(cv::Mat& gray) override {
+        gray = base_.clone();
+        int r = std::max(8, base_.rows / 6);
+        int x = static_cast<int>(frame_ * 7 % static_cast<std::uint64_t>(base_.cols));
+        int y = base_.rows / 2 + static_cast<int>((frame_ * 3) % static_cast<std::uint64_t>(base_.rows / 2)) - base_.rows / 4;
+        cv::circle(gray, cv::Point(x, y), r, cv::Scalar(230), -1);
+        frame_++;
+        return true;
+    }
+
+    double fps() const override { return fps_; }
+
+private:
+    double        fps_;
+    cv::Mat       base_;
+    std::uint64_t frame_ = 0;
+};
+
+// "synthetic:WxH@FPS" or a video file
+std::unique_ptr<Source> openSource(const std::string& spec)
+{
+    const std::string prefix = "synthetic:";
+    if (spec.rfind(prefix, 0) == 0) {
+        int w = 0, h = 0;
+        double fps = 0;
+        if (std::sscanf(spec.c_str() + prefix.size(), "%dx%d@%lf", &w, &h, &fps) != 3 || w <= 0 || h <= 0 || fps <= 0)
+            return nullptr;
+        return std::make_unique<SyntheticSource>(w, h, fps);
+    }
+    auto video = std::make_unique<VideoSource>(spec);
+    if (!video->opened()) return nullptr;
+    return video;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " <cascade_file> [--workers N] [--deadline-ms D] [--seconds S]\n"
+                  << "       <source> [more sources...]\n"
+                  << "  source: video file, or synthetic:WxH@FPS\n";
+        return 1;
+    }
+
+    unsigned workers = std::max(1u, std::thread::hardware_concurrency());
+    double deadline_ms = 200, seconds = 10;
+    std::vector<std::string> specs;
+    for (int i = 2; i < argc; ++i) {
+        std::string a = argv[i];
+        if (a == "--workers" && i + 1 < argc) workers = static_cast<unsigned>(std::max(1, std::stoi(argv[++i])));
+        else if (a == "--deadline-ms" && i + 1 < argc) deadline_ms = std::stod(argv[++i]);
+        else if (a == "--seconds" && i + 1 < argc) seconds = std::stod(argv[++i]);
+        else specs.push_back(a);
+    }
+    if (specs.empty()) {
+        std::cerr << "no sources given\n";
+        return 1;
+    }
+
+    std::ifstream in(argv[1]);
+    if (!in) {
+        std::cerr << "erorik: could not open cascade file " << argv[1] << "\n";
+        return 1;
+    }
+    const vj::Detector<int> detector(vj::CascadeClassifier<int>::load(in));
+
+    std::vector<std::unique_ptr<Source>> sources;
+    for (auto const& spec : specs) {
+        auto s = openSource(spec);
+        if (!s) {
+            std::cerr << "could not open source " << spec << "\n";
+            return 1;
+        }
+        sources.push_back(std::move(s));
+    }
+
+    vj::trace::startFromEnv();
+
+    const auto deadline = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double, std::milli>(deadline_ms));
+    vj::StreamScheduler<cv::Mat> scheduler(sources.size(), deadline);
+    std::atomic<bool> running{true};
+
+    // one thread per source, paced at the source frame rate like a live camera
+    std::vector<std::thread> producers;
+    for (std::size_t i = 0; i < sources.size(); ++i) {
+        producers.emplace_back([&, i] {
+            auto period = std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<double>(1.0 / sources[i]->fps()));
+            auto next = Clock::now();
+            while (running.load(std::memory_order_relaxed)) {
+                cv::Mat gray;
+                {
+                    VJ_TRACE_SCOPE("capture");
+                    if (!sources[i]->read(gray)) {
+                        std::cerr << "warning: stream " << i << " ended\n";
+                        break;
+                    }
+                }
+                scheduler.submit(i, std::move(gray));
+                next += period;
+                std::this_thread::sleep_until(next);
+            }
+        });
+    }
+
+    std::vector<std::atomic<std::uint64_t>> faces(sources.size());
+    std::vector<std::thread> pool;
+    for (unsigned w = 0; w < workers; ++w) {
+        pool.emplace_back([&] {
+            while (auto job = scheduler.next()) {
+                auto found = detector.detect(lumaView(job->frame));
+                scheduler.done(*job);
+                // two frames of one stream can be in flight on different workers
+                faces[job->stream].fetch_add(found.size(), std::memory_order_relaxed);
+            }
+        });
+    }
+
+    auto start = Clock::now();
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    running = false;
+    for (auto& t : producers) t.join();
+    scheduler.close();
+    for (auto& t : pool) t.join();
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    vj::trace::finish();
+
+    // per-stream report
+    auto stats = scheduler.stats();
+    std::size_t within_budget = 0;
+    double total_fps = 0;
+    std::cout << std::setw(7) << "stream" << std::setw(10) << "in fps" << std::setw(10) << "out fps"
+              << std::setw(10) << "replaced" << std::setw(9) << "expired" << std::setw(7) << "late"
+              << std::setw(11) << "mean ms" << std::setw(10) << "max ms" << std::setw(8) << "faces"
+              << "  source\n";
+    for (std::size_t i = 0; i < stats.size(); ++i) {
+        auto const& s = stats[i];
+        double out_fps = s.processed / elapsed;
+        total_fps += out_fps;
+        // on budget: nothing dropped for age and (almost) nothing finished late
+        if (s.expired == 0 && s.late * 100 <= s.processed) within_budget++;
+        std::cout << std::fixed << std::setprecision(1)
+                  << std::setw(7) << i << std::setw(10) << s.submitted / elapsed << std::setw(10) << out_fps
+                  << std::setw(10) << s.replaced << std::setw(9) << s.expired << std::setw(7) << s.late
+                  << std::setw(11) << s.meanLatencyMs() << std::setw(10) << s.maxLatencyMs()
+                  << std::setw(8) << faces[i].load() << "  " << specs[i] << "\n";
+    }
+    std::cout << "workers: " << workers << ", total " << total_fps << " frames/s, "
+              << within_budget << "/" << stats.size() << " streams within the "
+              << deadline_ms << " ms budget\n";
+    return 0;
+}
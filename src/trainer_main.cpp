@@ -4,21 +4,55 @@
 #include <iostream>
 #include <fstream>
 #include <iomanip>
+#include <string>
+#include <algorithm>
 #include "viola_jones/Trainer.h"
 #include "viola_jones/utils.hpp"
+#include "viola_jones/Trace.h"
 
 int main(int argc, char** argv) {
-    if (argc != 4) {
+    if (argc < 4) {
       std::cerr << "Usage: " << argv[0]
-                << " <pos_glob> <neg_glob> <out_cascade_file>\n";
+                << " <pos_glob> <neg_glob> <out_cascade_file> [--rounds 20] [--boosting discrete|real|gentle]\n"
+                << "       [--bins N] [--trim-beta 0.99] [--neg-subsample N] [--seed S]\n";
       return 1;
     }
 
 
+    // VJ_TRACE=<file> records a timeline (needs -DENABLE_TRACING=ON)
+    vj::trace::startFromEnv();
+
     vj::TrainerOptions opts;
     opts.window_size = 24;
     opts.num_rounds  = 20;
 
+    for (int i = 4; i + 1 < argc; i += 2) {
+      std::string k = argv[i], v = argv[i + 1];
+      if (k == "--rounds") {
+        opts.num_rounds = std::max<std::size_t>(1, std::stoul(v));
+      } else if (k == "--boosting") {
+        if (v == "discrete") opts.boosting = vj::Boosting::Discrete;
+        else if (v == "real") opts.boosting = vj::Boosting::Real;
+        else if (v == "gentle") opts.boosting = vj::Boosting::Gentle;
+        else { std::cerr << "unknown boosting " << v << "\n"; return 1; }
+      } else if (k == "--bins") {
+        opts.lut_bins = std::clamp<std::size_t>(std::stoul(v), 2, vj::kMaxLutBins);
+      } else if (k == "--trim-beta") {
+        opts.trim_beta = std::stod(v);
+        if (!(opts.trim_beta > 0 && opts.trim_beta <= 1)) {
+          std::cerr << "--trim-beta must be in (0, 1]\n";
+          return 1;
+        }
+      } else if (k == "--neg-subsample") {
+        opts.neg_subsample = std::stoul(v);
+      } else if (k == "--seed") {
+        opts.seed = static_cast<unsigned>(std::stoul(v));
+      } else {
+        std::cerr << "unknown option " << k << "\n";
+        return 1;
+      }
+    }
+
     auto posIs = loadIntegralSamples(argv[1], opts.window_size);
     auto negIs = loadIntegralSamples(argv[2], opts.window_size);
     if (posIs.empty() || negIs.empty()) {
@@ -60,6 +94,7 @@ int main(int argc, char** argv) {
     std::cout.flush();
 
     auto cascade = vj::Trainer::trainCascade(posIs, negIs, opts, progressCallback);
+    vj::trace::finish();
 
     // complete the progress bar at 100%
     int barWidth = 50;